@@ -1,23 +1,54 @@
 #ifndef BULLSAT_HPP_
 #define BULLSAT_HPP_
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
+#include <limits>
 #include <memory>
-#include <numeric>
+#include <mutex>
+#include <new>
 #include <optional>
-#include <regex>
+#include <poll.h>
 #include <set>
-#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
 #include <unordered_set>
 #include <utility>
 #include <vector>
+#ifdef BULLSAT_ZLIB
+#define ZLIB_CONST
+#include <zlib.h>
+#endif
+#ifdef BULLSAT_LZMA
+#include <lzma.h>
+#endif
+#ifdef BULLSAT_BZIP2
+#include <bzlib.h>
+#endif
 
 namespace bullsat {
 
 // definitions
-enum class LitBool { True, False, Undefine };
+enum class LitBool : uint8_t { True, False, Undefine };
 using Var = int;
 struct Lit;
 using Clause = std::vector<Lit>;
@@ -176,533 +207,4689 @@ struct Heap {
   }
 };
 
+// Variable-move-to-front queue
+// Variables are linked in the order of their enqueue time stamps and a bumped
+// variable moves to the end (the front of the queue) in O(1).
+struct Vmtf {
+  static constexpr Var NONE = -1;
+  std::vector<Var> prev, next;
+  std::vector<uint64_t> stamp;
+  Var first = NONE, last = NONE;
+  // No unassigned variables are after this one.
+  Var search = NONE;
+  uint64_t stamps = 0;
+  Vmtf() = default;
+
+  // Enqueue a new unassigned variable at the front.
+  void push(Var v) {
+    const size_t idx = static_cast<size_t>(v);
+    if (idx >= stamp.size()) {
+      prev.resize(idx + 1, NONE);
+      next.resize(idx + 1, NONE);
+      stamp.resize(idx + 1, 0);
+    }
+    link(v);
+    search = v;
+  }
+  void bump(Var v) {
+    if (v == last) {
+      return;
+    }
+    unlink(v);
+    link(v);
+  }
+  // v becomes unassigned.
+  void update(Var v) {
+    if (search == NONE ||
+        stamp[static_cast<size_t>(v)] > stamp[static_cast<size_t>(search)]) {
+      search = v;
+    }
+  }
+  // The most recently bumped unassigned variable.
+  template <class Assigned>
+  std::optional<Var> next_unassigned(Assigned assigned) {
+    Var v = search;
+    while (v != NONE && assigned(v)) {
+      v = prev[static_cast<size_t>(v)];
+    }
+    search = v;
+    if (v == NONE) {
+      return {};
+    }
+    return v;
+  }
+
+private:
+  void link(Var v) {
+    const size_t idx = static_cast<size_t>(v);
+    prev[idx] = last;
+    next[idx] = NONE;
+    if (last != NONE) {
+      next[static_cast<size_t>(last)] = v;
+    } else {
+      first = v;
+    }
+    last = v;
+    stamp[idx] = ++stamps;
+  }
+  void unlink(Var v) {
+    const size_t idx = static_cast<size_t>(v);
+    const Var p = prev[idx], n = next[idx];
+    if (p != NONE) {
+      next[static_cast<size_t>(p)] = n;
+    } else {
+      first = n;
+    }
+    if (n != NONE) {
+      prev[static_cast<size_t>(n)] = p;
+    } else {
+      last = p;
+    }
+  }
+};
+
+// Clause Arena
+// A clause reference is a 32-bit offset into the arena.
+using CRef = uint32_t;
+static_assert(sizeof(Lit) == sizeof(uint32_t), "Lit must fit in an arena word");
+
+// A clause stored in the arena: a fixed header followed by its literals.
+class ArenaClause {
+public:
+  ArenaClause(const Lit *lits, size_t size, bool learnt)
+      : size_(static_cast<uint32_t>(size)), learnt_(learnt), deleted_(false),
+        reloced_(false), used_(false), vivified_(false), lbd_(0),
+        activity_(0.0f) {
+    std::copy(lits, lits + size, begin());
+  }
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool learnt() const { return learnt_; }
+  [[nodiscard]] bool deleted() const { return deleted_; }
+  void mark_deleted() { deleted_ = true; }
+  // used in conflict analysis since the last reduction
+  [[nodiscard]] bool used() const { return used_; }
+  void set_used(bool used) { used_ = used; }
+  // already tried by vivification
+  [[nodiscard]] bool vivified() const { return vivified_; }
+  void set_vivified(bool vivified) { vivified_ = vivified; }
+  // literal block distance: the number of decision levels in the clause
+  [[nodiscard]] uint32_t lbd() const { return lbd_; }
+  void set_lbd(uint32_t lbd) { lbd_ = std::min(lbd, MAX_LBD) & MAX_LBD; }
+  [[nodiscard]] float activity() const { return activity_; }
+  void set_activity(float activity) { activity_ = activity; }
+
+  Lit &operator[](size_t i) { return begin()[i]; }
+  const Lit &operator[](size_t i) const { return begin()[i]; }
+  Lit *begin() { return reinterpret_cast<Lit *>(this + 1); }
+  Lit *end() { return begin() + size_; }
+  const Lit *begin() const { return reinterpret_cast<const Lit *>(this + 1); }
+  const Lit *end() const { return begin() + size_; }
+
+private:
+  friend class ClauseArena;
+  uint32_t size_;
+  uint32_t learnt_ : 1;
+  uint32_t deleted_ : 1;
+  // the clause has been moved and lits[0] holds the new reference
+  uint32_t reloced_ : 1;
+  uint32_t used_ : 1;
+  uint32_t vivified_ : 1;
+  uint32_t lbd_ : 27;
+  float activity_;
+  static constexpr uint32_t MAX_LBD = (1u << 27) - 1;
+};
+
+class ClauseArena {
+public:
+  ClauseArena() : wasted_(0) {}
+  static size_t words(size_t size) { return HEADER_WORDS + size; }
+
+  CRef alloc(const Lit *lits, size_t size, bool learnt) {
+    assert(size > 1);
+    const size_t cr = memory.size();
+    assert(cr + words(size) <= std::numeric_limits<CRef>::max());
+    memory.resize(cr + words(size));
+    new (&memory[cr]) ArenaClause(lits, size, learnt);
+    return static_cast<CRef>(cr);
+  }
+  CRef alloc(const Clause &lits, bool learnt) {
+    return alloc(lits.data(), lits.size(), learnt);
+  }
+  void free(CRef cr) { wasted_ += words((*this)[cr].size()); }
+  ArenaClause &operator[](CRef cr) {
+    return *reinterpret_cast<ArenaClause *>(&memory[cr]);
+  }
+  const ArenaClause &operator[](CRef cr) const {
+    return *reinterpret_cast<const ArenaClause *>(&memory[cr]);
+  }
+  // Move a clause to `to` and update `cr`.
+  // A moved clause leaves a forwarding reference so that the other holders of
+  // `cr` are updated to the same place.
+  void reloc(CRef &cr, ClauseArena &to) {
+    ArenaClause &clause = (*this)[cr];
+    if (clause.reloced_) {
+      cr = static_cast<CRef>(clause[0].x);
+      return;
+    }
+    const CRef new_cr = to.alloc(clause.begin(), clause.size(), clause.learnt());
+    to[new_cr].used_ = clause.used_;
+    to[new_cr].vivified_ = clause.vivified_;
+    to[new_cr].lbd_ = clause.lbd_;
+    to[new_cr].activity_ = clause.activity_;
+    clause.reloced_ = true;
+    clause[0].x = static_cast<int>(new_cr);
+    cr = new_cr;
+  }
+  void reserve(size_t n) { memory.reserve(n); }
+  [[nodiscard]] size_t size() const { return memory.size(); }
+  [[nodiscard]] size_t wasted() const { return wasted_; }
+
+private:
+  static constexpr size_t HEADER_WORDS =
+      sizeof(ArenaClause) / sizeof(uint32_t);
+  std::vector<uint32_t> memory;
+  size_t wasted_;
+};
+
+// A watcher keeps a literal of the clause as a blocker.
+// If the blocker is true, the clause is satisfied and the clause memory does
+// not need to be touched.
+struct Watcher {
+  Watcher(CRef c, Lit b) : cref(c), blocker(b) {}
+  CRef cref;
+  Lit blocker;
+};
+
+// The reason of an implied literal.
+// It is either a clause in the arena or, for a binary clause, the other
+// literal of the clause. Binary clauses only live in implication lists.
+class Reason {
+public:
+  static Reason clause(CRef cr) {
+    assert((cr & BINARY) == 0);
+    return Reason(cr);
+  }
+  static Reason binary(Lit other) {
+    return Reason(BINARY | static_cast<uint32_t>(other.x));
+  }
+  [[nodiscard]] bool is_binary() const { return x & BINARY; }
+  [[nodiscard]] CRef cref() const {
+    assert(!is_binary());
+    return x;
+  }
+  [[nodiscard]] Lit lit() const {
+    assert(is_binary());
+    Lit l;
+    l.x = static_cast<int>(x & ~BINARY);
+    return l;
+  }
+  bool operator==(Reason r) const { return x == r.x; }
+
+private:
+  static constexpr uint32_t BINARY = 1u << 31;
+  explicit Reason(uint32_t raw) : x(raw) {}
+  uint32_t x;
+};
+
+// A clause whose literals are all false.
+struct Conflict {
+  explicit Conflict(CRef cr) : cref(cr), binary(false), lits{} {}
+  Conflict(Lit first, Lit second)
+      : cref(0), binary(true), lits{first, second} {}
+  CRef cref;
+  bool binary;
+  // the literals of a binary clause
+  Lit lits[2];
+};
+
+// A formula in a flat literal buffer
+struct CnfData {
+  std::optional<size_t> var_num;
+  std::optional<size_t> clause_num;
+  // literals of all clauses
+  std::vector<Lit> lits;
+  // clause i is lits[offsets[i]..offsets[i + 1])
+  std::vector<size_t> offsets = {0};
+
+  [[nodiscard]] size_t num_clauses() const { return offsets.size() - 1; }
+  [[nodiscard]] Clause clause(size_t i) const {
+    return Clause(lits.begin() + static_cast<std::ptrdiff_t>(offsets[i]),
+                  lits.begin() + static_cast<std::ptrdiff_t>(offsets[i + 1]));
+  }
+};
+
+// xorshift64*
+class Random {
+public:
+  explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+  }
+  // [0, n)
+  uint64_t below(uint64_t n) { return next() % n; }
+  // [0, 1)
+  double real() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+
+private:
+  uint64_t state;
+};
+
+// Restart
+// The Luby sequence 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8 ... with the base y.
+inline double luby(double y, uint64_t x) {
+  uint64_t size = 1;
+  int seq = 0;
+  while (size < x + 1) {
+    seq++;
+    size = 2 * size + 1;
+  }
+  while (size - 1 != x) {
+    size = (size - 1) >> 1;
+    seq--;
+    x = x % size;
+  }
+  return std::pow(y, seq);
+}
+
+// Exponential moving average with bias correction.
+struct Ema {
+  explicit Ema(double smoothing)
+      : value(0.0), biased(0.0), beta(1.0), alpha(smoothing) {}
+  void update(double x) {
+    biased += alpha * (x - biased);
+    beta *= 1.0 - alpha;
+    value = beta < 1.0 ? biased / (1.0 - beta) : biased;
+  }
+  double value, biased, beta, alpha;
+};
+
+class RestartPolicy {
+public:
+  RestartPolicy() = default;
+  RestartPolicy(const RestartPolicy &) = default;
+  RestartPolicy &operator=(const RestartPolicy &) = default;
+  virtual ~RestartPolicy() = default;
+  // Called after each conflict with the LBD of the learnt clause.
+  virtual void on_conflict(uint32_t lbd) = 0;
+  [[nodiscard]] virtual bool should_restart() const = 0;
+  virtual void on_restart() = 0;
+};
+
+// Restart after unit * luby(2, i) conflicts.
+class LubyRestart final : public RestartPolicy {
+public:
+  explicit LubyRestart(double first) : unit(first), index(0), conflicts(0) {}
+  void on_conflict(uint32_t) override { conflicts++; }
+  [[nodiscard]] bool should_restart() const override {
+    return static_cast<double>(conflicts) >= unit * luby(2, index);
+  }
+  void on_restart() override {
+    index++;
+    conflicts = 0;
+  }
+
+private:
+  double unit;
+  uint64_t index;
+  uint64_t conflicts;
+};
+
+// Restart after first * factor^i conflicts.
+class GeometricRestart final : public RestartPolicy {
+public:
+  GeometricRestart(double first, double growth)
+      : limit(first), factor(growth), conflicts(0) {}
+  void on_conflict(uint32_t) override { conflicts++; }
+  [[nodiscard]] bool should_restart() const override {
+    return static_cast<double>(conflicts) >= limit;
+  }
+  void on_restart() override {
+    limit *= factor;
+    conflicts = 0;
+  }
+
+private:
+  double limit;
+  double factor;
+  uint64_t conflicts;
+};
+
+// Restart when the recent LBDs are worse than the long term average.
+class GlucoseRestart final : public RestartPolicy {
+public:
+  GlucoseRestart() : fast(1.0 / 32), slow(1.0 / 4096), conflicts(0) {}
+  void on_conflict(uint32_t lbd) override {
+    fast.update(lbd);
+    slow.update(lbd);
+    conflicts++;
+  }
+  [[nodiscard]] bool should_restart() const override {
+    return conflicts >= MIN_CONFLICTS && fast.value > MARGIN * slow.value;
+  }
+  void on_restart() override { conflicts = 0; }
+
+private:
+  static constexpr uint64_t MIN_CONFLICTS = 2;
+  static constexpr double MARGIN = 1.1;
+  Ema fast, slow;
+  uint64_t conflicts;
+};
+
+enum class RestartKind { Luby, Geometric, Glucose };
+// Focused mode restarts often by the selected restart policy.
+// Stable mode rarely restarts. Switch alternates them.
+enum class SearchMode { Focused, Stable, Switch };
+
+// Decision heuristic
+// Auto uses VMTF in focused mode and EVSIDS in stable mode.
+// Lrb orders the heap by the learning rate of each variable.
+enum class DecisionKind { Evsids, Vmtf, Auto, Lrb };
+
+enum class Rephase { Original, Inverted, Best, Walk, Random };
+
+struct Options {
+  RestartKind restart = RestartKind::Glucose;
+  SearchMode mode = SearchMode::Switch;
+  DecisionKind decision = DecisionKind::Evsids;
+  // the original phase of every variable
+  bool initial_phase = false;
+  // decide by target phases in stable mode
+  bool target_phase = true;
+  // EVSIDS activity decay per conflict
+  double var_decay = 0.95;
+  // reset the saved phases periodically
+  bool rephase = true;
+  // simplify the formula before the first solve()
+  bool preprocess = true;
+  // probe failed literals and substitute equivalent literals periodically
+  bool inprocess = true;
+  // shorten clauses by vivification periodically
+  bool vivify = true;
+  uint64_t seed = 0;
+};
+
+// Limits of each solve() call. No limit by default.
+struct Budget {
+  std::optional<uint64_t> conflicts;
+  // propagated literals
+  std::optional<uint64_t> propagations;
+  // watch lists and clauses visited in propagation
+  std::optional<uint64_t> ticks;
+  // wall-clock time
+  std::optional<double> seconds;
+};
+
+// Proof logging
+// DRAT proofs in the text or the binary format of drat-trim, written
+// through a large buffer. A solver logs only if its traits enable proofs,
+// which the default traits do when BULLSAT_PROOF is defined.
+#ifdef BULLSAT_PROOF
+inline constexpr bool PROOF_ENABLED = true;
+#else
+inline constexpr bool PROOF_ENABLED = false;
+#endif
+enum class ProofFormat { Drat, BinaryDrat };
+
+class ProofWriter {
+public:
+  // The descriptor is not closed.
+  ProofWriter(int out, ProofFormat proof_format)
+      : fd(out), format(proof_format), failed(false) {
+    buffer.reserve(BUFFER_SIZE + MAX_LINE);
+  }
+  ProofWriter(const ProofWriter &) = delete;
+  ProofWriter &operator=(const ProofWriter &) = delete;
+  ~ProofWriter() { flush(); }
+  template <class It> void add(It begin, It end) { line(false, begin, end); }
+  template <class It> void remove(It begin, It end) {
+    line(true, begin, end);
+  }
+  // Write the buffer. Return false if a write has failed.
+  bool flush() {
+    size_t written = 0;
+    while (!failed && written < buffer.size()) {
+      const ssize_t n =
+          ::write(fd, buffer.data() + written, buffer.size() - written);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        failed = true;
+        break;
+      }
+      written += static_cast<size_t>(n);
+    }
+    buffer.clear();
+    return !failed;
+  }
+
+private:
+  static constexpr size_t BUFFER_SIZE = 1 << 20;
+  // flush before a literal may not fit
+  static constexpr size_t MAX_LINE = 32;
+  template <class It> void line(bool deletion, It begin, It end) {
+    if (format == ProofFormat::BinaryDrat) {
+      buffer.push_back(deletion ? 'd' : 'a');
+      for (It it = begin; it != end; ++it) {
+        reserve();
+        // 2 * (var + 1) + sign in 7-bit groups, the lowest first
+        uint64_t x = static_cast<uint64_t>(it->x) + 2;
+        while (x > 127) {
+          buffer.push_back(static_cast<char>(0x80 | (x & 127)));
+          x >>= 7;
+        }
+        buffer.push_back(static_cast<char>(x));
+      }
+      buffer.push_back(0);
+    } else {
+      if (deletion) {
+        buffer.push_back('d');
+        buffer.push_back(' ');
+      }
+      for (It it = begin; it != end; ++it) {
+        reserve();
+        if (it->neg()) {
+          buffer.push_back('-');
+        }
+        char digits[16];
+        size_t n = 0;
+        for (uint64_t v = static_cast<uint64_t>(it->var()) + 1; v > 0;
+             v /= 10) {
+          digits[n++] = static_cast<char>('0' + v % 10);
+        }
+        while (n > 0) {
+          buffer.push_back(digits[--n]);
+        }
+        buffer.push_back(' ');
+      }
+      buffer.push_back('0');
+      buffer.push_back('\n');
+    }
+    reserve();
+  }
+  void reserve() {
+    if (buffer.size() >= BUFFER_SIZE) {
+      flush();
+    }
+  }
+
+  int fd;
+  ProofFormat format;
+  std::vector<char> buffer;
+  bool failed;
+};
+
+// SatELite-style preprocessing
+// Backward subsumption, self-subsuming strengthening and bounded variable
+// elimination over a formula without assigned variables.
+// Eliminated clauses are kept on a stack to extend a model of the result.
+class Eliminator {
+public:
+  // Strengthened clauses, resolvents and removed clauses are logged to
+  // `to` if it is given.
+  Eliminator(size_t num_vars, const std::vector<bool> &frozen_vars,
+             ProofWriter *to = nullptr)
+      : occurs(2 * num_vars), values(2 * num_vars, LitBool::Undefine),
+        unit_head(0), touched(num_vars, true), frozen(frozen_vars),
+        eliminated(num_vars, false), marks(2 * num_vars, false),
+        elim_offsets{0}, steps(0), unsat(false), proof(to) {}
+
+  // Add a clause without duplicated or complementary literals.
+  void add_clause(Clause clause) {
+    if (clause.empty()) {
+      unsat = true;
+    } else if (clause.size() == 1) {
+      assign(clause[0]);
+    } else {
+      const uint32_t c = static_cast<uint32_t>(db.size());
+      for (const Lit lit : clause) {
+        occurs[lit.lidx()].push_back(c);
+      }
+      sigs.push_back(signature(clause));
+      db.push_back(std::move(clause));
+      removed.push_back(false);
+      queued.push_back(true);
+      subsume_queue.push_back(c);
+    }
+  }
+  // Simplify the formula in at most step_limit steps.
+  // Return false if it is unsatisfiable.
+  bool run(uint64_t step_limit) {
+    propagate_units();
+    subsume(step_limit);
+    while (!unsat && steps < step_limit) {
+      std::vector<Var> candidates;
+      for (size_t v = 0; v < touched.size(); v++) {
+        if (touched[v] && !frozen[v] && !eliminated[v] &&
+            values[Lit(Var(v), true).lidx()] == LitBool::Undefine) {
+          candidates.push_back(Var(v));
+        }
+        touched[v] = false;
+      }
+      if (candidates.empty()) {
+        break;
+      }
+      // cheap ones first
+      std::vector<size_t> costs(touched.size(), 0);
+      for (const Var v : candidates) {
+        costs[static_cast<size_t>(v)] = live_occurs(Lit(v, true)).size() *
+                                        live_occurs(Lit(v, false)).size();
+      }
+      std::sort(candidates.begin(), candidates.end(), [&](Var a, Var b) {
+        return costs[static_cast<size_t>(a)] < costs[static_cast<size_t>(b)];
+      });
+      for (const Var v : candidates) {
+        if (unsat || steps >= step_limit) {
+          break;
+        }
+        if (eliminate(v)) {
+          propagate_units();
+          subsume(step_limit);
+        }
+      }
+    }
+    return !unsat;
+  }
+  // The remaining clauses
+  [[nodiscard]] std::vector<Clause> clauses() const {
+    std::vector<Clause> result;
+    for (size_t c = 0; c < db.size(); c++) {
+      if (!removed[c]) {
+        result.push_back(db[c]);
+      }
+    }
+    return result;
+  }
+  [[nodiscard]] const std::vector<Lit> &units() const { return unit_lits; }
+  [[nodiscard]] const std::vector<bool> &eliminated_vars() const {
+    return eliminated;
+  }
+  // Clauses removed by elimination. The first literal of each clause is the
+  // eliminated one.
+  [[nodiscard]] const std::vector<Lit> &eliminated_lits() const {
+    return elim_lits;
+  }
+  [[nodiscard]] const std::vector<size_t> &eliminated_offsets() const {
+    return elim_offsets;
+  }
+
+private:
+  static uint64_t signature(const Clause &clause) {
+    uint64_t sig = 0;
+    for (const Lit lit : clause) {
+      sig |= 1ull << (lit.vidx() & 63);
+    }
+    return sig;
+  }
+  void touch(const Clause &clause) {
+    for (const Lit lit : clause) {
+      touched[lit.vidx()] = true;
+    }
+  }
+  void assign(Lit lit) {
+    if (values[lit.lidx()] == LitBool::True) {
+      return;
+    }
+    if (values[lit.lidx()] == LitBool::False) {
+      unsat = true;
+      return;
+    }
+    values[lit.lidx()] = LitBool::True;
+    values[(~lit).lidx()] = LitBool::False;
+    unit_lits.push_back(lit);
+  }
+  void remove(uint32_t c) {
+    removed[c] = true;
+    touch(db[c]);
+    // a unit stays in the proof as the value of its literal
+    if (db[c].size() > 1) {
+      proof_delete(db[c]);
+    }
+  }
+  template <class Lits> void proof_add(const Lits &lits) {
+    if (proof) {
+      proof->add(lits.begin(), lits.end());
+    }
+  }
+  template <class Lits> void proof_delete(const Lits &lits) {
+    if (proof) {
+      proof->remove(lits.begin(), lits.end());
+    }
+  }
+  // Remove a literal from a clause.
+  void strengthen(uint32_t c, Lit lit) {
+    Clause &clause = db[c];
+    const auto it_lit = std::find(clause.begin(), clause.end(), lit);
+    if (proof) {
+      Clause strengthened = clause;
+      strengthened.erase(strengthened.begin() + (it_lit - clause.begin()));
+      proof_add(strengthened);
+      proof_delete(clause);
+    }
+    clause.erase(it_lit);
+    std::vector<uint32_t> &occ = occurs[lit.lidx()];
+    const auto it = std::find(occ.begin(), occ.end(), c);
+    if (it != occ.end()) {
+      occ.erase(it);
+    }
+    touched[lit.vidx()] = true;
+    if (clause.size() == 1) {
+      assign(clause[0]);
+      remove(c);
+      return;
+    }
+    sigs[c] = signature(clause);
+    touch(clause);
+    if (!queued[c]) {
+      queued[c] = true;
+      subsume_queue.push_back(c);
+    }
+  }
+  void propagate_units() {
+    while (!unsat && unit_head < unit_lits.size()) {
+      const Lit lit = unit_lits[unit_head++];
+      for (const uint32_t c : occurs[lit.lidx()]) {
+        if (!removed[c]) {
+          remove(c);
+        }
+      }
+      occurs[lit.lidx()].clear();
+      const std::vector<uint32_t> falsified = std::move(occurs[(~lit).lidx()]);
+      occurs[(~lit).lidx()].clear();
+      for (const uint32_t c : falsified) {
+        if (!removed[c]) {
+          strengthen(c, ~lit);
+        }
+      }
+    }
+  }
+  // Drop removed clauses from the occurrence list of a literal.
+  const std::vector<uint32_t> &live_occurs(Lit lit) {
+    std::vector<uint32_t> &occ = occurs[lit.lidx()];
+    occ.erase(std::remove_if(occ.begin(), occ.end(),
+                             [&](uint32_t c) { return removed[c]; }),
+              occ.end());
+    return occ;
+  }
+  void subsume(uint64_t step_limit) {
+    while (!unsat && !subsume_queue.empty() && steps < step_limit) {
+      const uint32_t c = subsume_queue.back();
+      subsume_queue.pop_back();
+      queued[c] = false;
+      if (!removed[c]) {
+        backward_subsume(c);
+      }
+      propagate_units();
+    }
+  }
+  // Remove the clauses subsumed by c and strengthen the clauses that c
+  // subsumes with one literal flipped.
+  void backward_subsume(uint32_t c) {
+    const Clause clause = db[c];
+    Lit best = clause[0];
+    for (const Lit lit : clause) {
+      if (occurs[lit.lidx()].size() + occurs[(~lit).lidx()].size() <
+          occurs[best.lidx()].size() + occurs[(~best).lidx()].size()) {
+        best = lit;
+      }
+    }
+    if (occurs[best.lidx()].size() + occurs[(~best).lidx()].size() >
+        SUBSUME_OCC_LIMIT) {
+      return;
+    }
+    for (const Lit lit : clause) {
+      marks[lit.lidx()] = true;
+    }
+    std::vector<uint32_t> candidates = occurs[best.lidx()];
+    const std::vector<uint32_t> &negative = occurs[(~best).lidx()];
+    candidates.insert(candidates.end(), negative.begin(), negative.end());
+    for (const uint32_t d : candidates) {
+      if (d == c || removed[d] || db[d].size() < clause.size() ||
+          (sigs[c] & ~sigs[d]) != 0) {
+        continue;
+      }
+      steps += db[d].size();
+      size_t matched = 0;
+      std::optional<Lit> flipped;
+      for (const Lit lit : db[d]) {
+        if (marks[lit.lidx()]) {
+          matched++;
+        } else if (marks[(~lit).lidx()]) {
+          if (flipped) {
+            matched = 0;
+            break;
+          }
+          flipped = lit;
+        }
+      }
+      if (matched + (flipped ? 1 : 0) != clause.size()) {
+        continue;
+      }
+      if (!flipped) {
+        remove(d);
+      } else {
+        strengthen(d, flipped.value());
+      }
+      if (unsat) {
+        break;
+      }
+    }
+    for (const Lit lit : clause) {
+      marks[lit.lidx()] = false;
+    }
+  }
+  // The resolvent of a and b on v, or std::nullopt if it is a tautology.
+  std::optional<Clause> resolve(const Clause &a, const Clause &b, Var v) {
+    steps += a.size() + b.size();
+    Clause resolvent;
+    for (const Lit lit : a) {
+      if (lit.var() != v) {
+        marks[lit.lidx()] = true;
+        resolvent.push_back(lit);
+      }
+    }
+    bool tautology = false;
+    for (const Lit lit : b) {
+      if (lit.var() == v || marks[lit.lidx()]) {
+        continue;
+      }
+      if (marks[(~lit).lidx()]) {
+        tautology = true;
+        break;
+      }
+      resolvent.push_back(lit);
+    }
+    for (const Lit lit : a) {
+      marks[lit.lidx()] = false;
+    }
+    if (tautology) {
+      return std::nullopt;
+    }
+    return resolvent;
+  }
+  // Whether the resolvents on v are no more than the clauses and no longer
+  // than ELIM_CLAUSE_LIMIT, counted without building them.
+  bool bounded_resolvents(const std::vector<uint32_t> &pos,
+                          const std::vector<uint32_t> &neg, Var v) {
+    size_t count = 0;
+    bool bounded = true;
+    for (size_t i = 0; i < pos.size() && bounded; i++) {
+      const Clause &a = db[pos[i]];
+      for (const Lit lit : a) {
+        marks[lit.lidx()] = true;
+      }
+      for (size_t j = 0; j < neg.size() && bounded; j++) {
+        const Clause &b = db[neg[j]];
+        steps += b.size();
+        size_t size = a.size() - 1;
+        bool tautology = false;
+        for (const Lit lit : b) {
+          if (lit.var() == v || marks[lit.lidx()]) {
+            continue;
+          }
+          if (marks[(~lit).lidx()]) {
+            tautology = true;
+            break;
+          }
+          size++;
+        }
+        if (!tautology) {
+          count++;
+          bounded = size <= ELIM_CLAUSE_LIMIT &&
+                    count <= pos.size() + neg.size();
+        }
+      }
+      for (const Lit lit : a) {
+        marks[lit.lidx()] = false;
+      }
+    }
+    return bounded;
+  }
+  // Replace the clauses of v with their resolvents if it doesn't increase the
+  // number of clauses.
+  bool eliminate(Var v) {
+    const size_t idx = static_cast<size_t>(v);
+    if (eliminated[idx] || values[Lit(v, true).lidx()] != LitBool::Undefine) {
+      return false;
+    }
+    const std::vector<uint32_t> pos = live_occurs(Lit(v, true));
+    const std::vector<uint32_t> neg = live_occurs(Lit(v, false));
+    if (pos.size() + neg.size() > ELIM_OCC_LIMIT) {
+      return false;
+    }
+    if (!bounded_resolvents(pos, neg, v)) {
+      return false;
+    }
+    std::vector<Clause> resolvents;
+    for (const uint32_t p : pos) {
+      for (const uint32_t n : neg) {
+        if (std::optional<Clause> resolvent = resolve(db[p], db[n], v)) {
+          proof_add(resolvent.value());
+          resolvents.push_back(std::move(resolvent.value()));
+        }
+      }
+    }
+
+    eliminated[idx] = true;
+    for (const std::vector<uint32_t> *side : {&pos, &neg}) {
+      for (const uint32_t c : *side) {
+        const Lit pivot = side == &pos ? Lit(v, true) : Lit(v, false);
+        elim_lits.push_back(pivot);
+        for (const Lit lit : db[c]) {
+          if (lit != pivot) {
+            elim_lits.push_back(lit);
+          }
+        }
+        elim_offsets.push_back(elim_lits.size());
+        remove(c);
+      }
+    }
+    occurs[Lit(v, true).lidx()].clear();
+    occurs[Lit(v, false).lidx()].clear();
+    for (Clause &resolvent : resolvents) {
+      touch(resolvent);
+      add_clause(std::move(resolvent));
+    }
+    return true;
+  }
+
+  // do not check clauses with a literal that occurs more than this
+  static constexpr size_t SUBSUME_OCC_LIMIT = 1000;
+  // do not eliminate a variable with more occurrences than this
+  static constexpr size_t ELIM_OCC_LIMIT = 200;
+  // do not eliminate a variable if a resolvent is longer than this
+  static constexpr size_t ELIM_CLAUSE_LIMIT = 20;
+
+  std::vector<Clause> db;
+  std::vector<bool> removed;
+  // abstraction of the variables of a clause
+  std::vector<uint64_t> sigs;
+  // literal -> clauses
+  std::vector<std::vector<uint32_t>> occurs;
+  std::vector<LitBool> values;
+  std::vector<Lit> unit_lits;
+  size_t unit_head;
+  std::vector<uint32_t> subsume_queue;
+  std::vector<bool> queued;
+  // variables whose clauses are changed
+  std::vector<bool> touched;
+  std::vector<bool> frozen;
+  std::vector<bool> eliminated;
+  std::vector<bool> marks;
+  std::vector<Lit> elim_lits;
+  std::vector<size_t> elim_offsets;
+  uint64_t steps;
+  bool unsat;
+  ProofWriter *proof;
+};
+
+// Clause sharing
+// A ring of clauses written by one thread and read by others, each with its
+// own cursor. Every slot is guarded by a sequence number so that a reader
+// detects a slot overwritten while it is read. A reader that falls behind by
+// more than the capacity loses the overwritten clauses.
+class SharedRing {
+public:
+  static constexpr size_t MAX_SIZE = 16;
+  SharedRing() : slots(CAPACITY), head(0) {}
+
+  // Only the owner thread writes.
+  void push(const Lit *lits, size_t size, uint32_t lbd) {
+    assert(size <= MAX_SIZE);
+    const uint64_t pos = head.load(std::memory_order_relaxed);
+    Slot &slot = slots[pos % CAPACITY];
+    slot.seq.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.size.store(static_cast<uint32_t>(size), std::memory_order_relaxed);
+    slot.lbd.store(lbd, std::memory_order_relaxed);
+    for (size_t i = 0; i < size; i++) {
+      slot.lits[i].store(lits[i].x, std::memory_order_relaxed);
+    }
+    slot.seq.store(2 * pos + 2, std::memory_order_release);
+    head.store(pos + 1, std::memory_order_release);
+  }
+  // Read the clauses after `cursor` into `clause` and call f(clause, lbd).
+  template <class F> void read(uint64_t &cursor, Clause &clause, F f) const {
+    const uint64_t end = head.load(std::memory_order_acquire);
+    if (end - cursor > CAPACITY) {
+      cursor = end - CAPACITY;
+    }
+    for (; cursor < end; cursor++) {
+      const Slot &slot = slots[cursor % CAPACITY];
+      const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq != 2 * cursor + 2) {
+        continue;
+      }
+      const size_t size = std::min<size_t>(
+          slot.size.load(std::memory_order_relaxed), MAX_SIZE);
+      const uint32_t lbd = slot.lbd.load(std::memory_order_relaxed);
+      clause.resize(size);
+      for (size_t i = 0; i < size; i++) {
+        clause[i].x = slot.lits[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == seq) {
+        f(clause, lbd);
+      }
+    }
+  }
+
+private:
+  static constexpr size_t CAPACITY = 1 << 14;
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint32_t> size{0};
+    std::atomic<uint32_t> lbd{0};
+    std::atomic<int> lits[MAX_SIZE] = {};
+  };
+  std::vector<Slot> slots;
+  std::atomic<uint64_t> head;
+};
+
+// The rings of solvers that share learnt clauses. Solver i exports to ring i
+// and imports from the others.
+class ClauseExchange {
+public:
+  explicit ClauseExchange(size_t solvers) : rings(solvers) {}
+  [[nodiscard]] size_t size() const { return rings.size(); }
+  SharedRing &ring(size_t i) { return rings[i]; }
+
+private:
+  std::vector<SharedRing> rings;
+};
 
 // SAT Solver
 enum class Status { Sat, Unsat, Unknown };
-class Solver;
-// region
-using CRef = std::shared_ptr<Clause>;
-using CWRef = std::weak_ptr<Clause>;
 
-class Solver {
-public:
-  Solver() = default;
-  explicit Solver(size_t variable_num)
-      : skip_simplify(false), que_head(0), var_bump_inc(1.0) {
-    assings.resize(variable_num);
-    watchers.resize(2 * variable_num);
-    reasons.resize(variable_num);
-    levels.resize(variable_num);
-    seen.resize(variable_num);
-    que.clear();
-    for (size_t v = 0; v < variable_num; v++) {
-      order_heap.push(Var(v));
+// Per-variable data of an assigned variable.
+struct VarData {
+  std::optional<Reason> reason;
+  int level;
+};
+
+// Compile-time configuration of a solver. A feature that is off or a choice
+// that is fixed here compiles to nothing in the search. The
+// default leaves every choice to Options at run time.
+struct DefaultTraits {
+  // the decision heuristic, or std::nullopt for Options::decision
+  static constexpr std::optional<DecisionKind> decision = std::nullopt;
+  // the restart policy in focused mode, or std::nullopt for Options::restart
+  static constexpr std::optional<RestartKind> restart = std::nullopt;
+  // solve() under assumptions
+  static constexpr bool assumptions = true;
+  // log to the ProofWriter of set_proof()
+  static constexpr bool proof = PROOF_ENABLED;
+  // count into stats()
+  static constexpr bool stats = false;
+};
+
+// Counters of a solver whose traits enable stats
+struct Statistics {
+  uint64_t decisions = 0;
+  uint64_t learnt_units = 0;
+  uint64_t learnt_binaries = 0;
+  // literals of the learnt clauses after minimization
+  uint64_t learnt_literals = 0;
+  // literals removed from the learnt clauses by minimization
+  uint64_t minimized_literals = 0;
+  uint64_t reductions = 0;
+  // learnt clauses removed by reductions
+  uint64_t reduced_learnts = 0;
+};
+
+template <class Traits = DefaultTraits> class BasicSolver {
+public:
+  BasicSolver() : BasicSolver(0) {}
+  explicit BasicSolver(size_t variable_num)
+      : skip_simplify(false), que_head(0), binary_head(0), var_bump_inc(1.0),
+        lrb_step(LRB_STEP), clause_bump_inc(1.0), lbd_stamp(0), conflicts(0),
+        reduce_interval(REDUCE_FIRST), next_reduce(REDUCE_FIRST),
+        stable(false), restarts(0), mode_switch_interval(MODE_SWITCH_FIRST),
+        next_mode_switch(MODE_SWITCH_FIRST), target_assigned(0),
+        best_assigned(0), rephases(0), next_rephase(REPHASE_INTERVAL),
+        rng(0), propagations(0), ticks(0),
+        conflict_limit(std::numeric_limits<uint64_t>::max()),
+        propagation_limit(std::numeric_limits<uint64_t>::max()),
+        tick_limit(std::numeric_limits<uint64_t>::max()), budget_checks(0),
+        interrupted(false), inconsistent(false), preprocessed(false),
+        elim_offsets{0}, inprocessings(0), next_inprocess(INPROCESS_INTERVAL),
+        inprocess_ticks(0), exchange(nullptr), share_id(0),
+        share_lbd(CORE_LBD), share_recent(0),
+        next_share_adjust(SHARE_ADJUST_INTERVAL), exported(0), imported(0),
+        proof(nullptr), proof_head(0) {
+    grow_vars(variable_num);
+  }
+  [[nodiscard]] LitBool eval(Lit lit) const { return values[lit.lidx()]; }
+  [[nodiscard]] size_t num_vars() const { return vardata.size(); }
+  [[nodiscard]] int decision_level() const {
+    return static_cast<int>(trail_lim.size());
+  }
+  [[nodiscard]] const ArenaClause &clause(CRef cr) const { return arena[cr]; }
+  // The literals of a conflicting clause.
+  [[nodiscard]] Clause lits(const Conflict &conflict) const {
+    if (conflict.binary) {
+      return Clause{conflict.lits[0], conflict.lits[1]};
+    }
+    const ArenaClause &clause = arena[conflict.cref];
+    return Clause(clause.begin(), clause.end());
+  }
+  void new_decision(Lit lit, std::optional<Reason> reason = std::nullopt) {
+    trail_lim.push_back(trail.size());
+    enqueue(lit, reason);
+  }
+
+  void enqueue(Lit lit, std::optional<Reason> reason = std::nullopt) {
+    assert(eval(lit) == LitBool::Undefine);
+    values[lit.lidx()] = LitBool::True;
+    values[(~lit).lidx()] = LitBool::False;
+    vardata[lit.vidx()] = VarData{reason, decision_level()};
+    if (decision_kind() == DecisionKind::Lrb) {
+      LrbData &data = lrb[lit.vidx()];
+      data.assigned_at = conflicts;
+      data.participated = 0;
+      data.reasoned = 0;
+    }
+    trail.push_back(lit);
+  }
+
+  void pop_queue_until(int until_level) {
+    if (decision_level() <= until_level) {
+      return;
+    }
+    const size_t until = trail_lim[static_cast<size_t>(until_level)];
+    for (size_t i = trail.size(); i-- > until;) {
+      const Lit lit = trail[i];
+      if (decision_kind() == DecisionKind::Lrb) {
+        lrb_unassign(lit.var());
+      }
+      // a fixed heuristic keeps only its own queue
+      if constexpr (Traits::decision != DecisionKind::Vmtf) {
+        if (!order_heap.in_heap(lit.var())) {
+          order_heap.push(lit.var());
+        }
+      }
+      if constexpr (!Traits::decision.has_value() ||
+                    Traits::decision == DecisionKind::Vmtf) {
+        vmtf.update(lit.var());
+      }
+      values[lit.lidx()] = LitBool::Undefine;
+      values[(~lit).lidx()] = LitBool::Undefine;
+      phases[lit.vidx()] = lit.pos();
+    }
+    trail.resize(until);
+    trail_lim.resize(static_cast<size_t>(until_level));
+    que_head = until;
+    binary_head = until;
+  }
+  // The decision heuristic and the restart policy in focused mode. They are
+  // constants if the traits fix them.
+  [[nodiscard]] DecisionKind decision_kind() const {
+    if constexpr (Traits::decision.has_value()) {
+      return *Traits::decision;
+    } else {
+      return options.decision;
+    }
+  }
+  [[nodiscard]] RestartKind restart_kind() const {
+    if constexpr (Traits::restart.has_value()) {
+      return *Traits::restart;
+    } else {
+      return options.restart;
+    }
+  }
+  [[nodiscard]] bool use_vmtf() const {
+    return decision_kind() == DecisionKind::Vmtf ||
+           (decision_kind() == DecisionKind::Auto && !stable);
+  }
+  // Bump a variable used in conflict analysis by the current heuristic.
+  void bump_var(Var v) {
+    if (decision_kind() == DecisionKind::Lrb) {
+      lrb[static_cast<size_t>(v)].participated++;
+    } else if (use_vmtf()) {
+      vmtf_bumped.push_back(v);
+    } else {
+      var_bump_activity(v, var_bump_inc);
+    }
+  }
+  // Move the bumped variables to the front keeping their relative order.
+  void vmtf_bump_vars() {
+    std::sort(vmtf_bumped.begin(), vmtf_bumped.end(), [&](Var a, Var b) {
+      return vmtf.stamp[static_cast<size_t>(a)] <
+             vmtf.stamp[static_cast<size_t>(b)];
+    });
+    for (const Var v : vmtf_bumped) {
+      vmtf.bump(v);
+      if (eval(Lit(v, true)) == LitBool::Undefine) {
+        vmtf.update(v);
+      }
+    }
+    vmtf_bumped.clear();
+  }
+  // The learning rate of a variable is the ratio of conflicts it participated
+  // in (or was a reason of) while assigned. The score is its exponential
+  // moving average.
+  void lrb_unassign(Var v) {
+    const size_t idx = static_cast<size_t>(v);
+    LrbData &data = lrb[idx];
+    const uint64_t interval = conflicts - data.assigned_at;
+    if (interval > 0) {
+      const double rate = static_cast<double>(data.participated) /
+                          static_cast<double>(interval);
+      const double reason_rate = static_cast<double>(data.reasoned) /
+                                 static_cast<double>(interval);
+      double &score = order_heap.activity[idx];
+      score = (1.0 - lrb_step) * score + lrb_step * (rate + reason_rate);
+      if (order_heap.in_heap(v)) {
+        order_heap.update(v);
+      }
+    }
+    data.canceled = conflicts;
+  }
+  // Bump variables that are reasons of the learnt clause but not in it.
+  void lrb_bump_reason_side(const Clause &learnt_clause) {
+    for (const Lit lit : learnt_clause) {
+      const std::optional<Reason> &reason = vardata[lit.vidx()].reason;
+      if (!reason) {
+        continue;
+      }
+      Lit other;
+      const auto [begin, end] = reason_lits(reason.value(), other);
+      for (const Lit *it = begin; it != end; it++) {
+        const size_t idx = it->vidx();
+        if (!seen[idx] && vardata[idx].level > 0) {
+          seen[idx] = true;
+          lrb[idx].reasoned++;
+          analyze_toclear.push_back(*it);
+        }
+      }
+    }
+  }
+  // Decay the score of an unassigned variable at the top of the heap by the
+  // conflicts since it was unassigned, until the top is up to date.
+  void lrb_decay_top() {
+    while (std::optional<Var> v = order_heap.top()) {
+      LrbData &data = lrb[static_cast<size_t>(v.value())];
+      const uint64_t age = conflicts - data.canceled;
+      if (age == 0) {
+        break;
+      }
+      order_heap.activity[static_cast<size_t>(v.value())] *=
+          std::pow(LRB_DECAY, static_cast<double>(age));
+      data.canceled = conflicts;
+      order_heap.decrease(v.value());
+    }
+  }
+  void var_bump_activity(Var v, double inc) {
+    const size_t idx = static_cast<size_t>(v);
+    order_heap.activity[idx] += inc;
+    if (order_heap.activity[idx] > 1e100) {
+      // rescale
+      for (size_t i = 0; i < order_heap.activity.size(); i++) {
+        order_heap.activity[i] *= 1e-100;
+      }
+      var_bump_inc *= 1e-100;
+    }
+    if (order_heap.in_heap(v)) {
+      order_heap.update(v);
+    }
+  }
+  void new_var() { grow_vars(num_vars() + 1); }
+  // Add variables until there are n variables.
+  void grow_vars(size_t n) {
+    const size_t old = num_vars();
+    if (n <= old) {
+      return;
+    }
+    // literal index
+    values.resize(2 * n, LitBool::Undefine);
+    watchers.resize(2 * n);
+    implications.resize(2 * n);
+    // variable index
+    vardata.resize(n, VarData{std::nullopt, 0});
+    lrb.resize(n, LrbData{0, 0, 0, 0});
+    phases.resize(n, options.initial_phase);
+    target_phases.resize(n, 0);
+    best_phases.resize(n, 0);
+    seen.resize(n, false);
+    frozen.resize(n, false);
+    eliminated.resize(n, false);
+    // decision levels are in [0, n]
+    level_stamps.resize(n + 1, 0);
+    trail.reserve(n);
+    for (size_t v = old; v < n; v++) {
+      order_heap.push(Var(v));
+      vmtf.push(Var(v));
+    }
+  }
+  // (a v b) means !a -> b and !b -> a
+  void add_binary(Lit a, Lit b) {
+    implications[(~a).lidx()].push_back(b);
+    implications[(~b).lidx()].push_back(a);
+  }
+  void watch_clause(CRef cr) {
+    const ArenaClause &clause = arena[cr];
+    assert(clause.size() > 1);
+    watchers[(~clause[0]).lidx()].emplace_back(cr, clause[1]);
+    watchers[(~clause[1]).lidx()].emplace_back(cr, clause[0]);
+  }
+  void attach_clause(CRef cr) {
+    assert(arena[cr].size() > 1);
+    watch_clause(cr);
+    if (arena[cr].learnt()) {
+      learnts.push_back(cr);
+    } else {
+      clauses.push_back(cr);
+    }
+  }
+  // Mark a clause as deleted and release its memory.
+  // Watchers that refer to the clause are removed lazily by clean_watchers().
+  void remove_clause(CRef cr) {
+    ArenaClause &clause = arena[cr];
+    if (locked(cr)) {
+      vardata[clause[0].vidx()].reason = std::nullopt;
+    }
+    clause.mark_deleted();
+    arena.free(cr);
+  }
+  // Proof logging. These compile to nothing unless Traits::proof.
+  void proof_add(const Lit *begin, const Lit *end) {
+    if constexpr (Traits::proof) {
+      if (proof) {
+        proof->add(begin, end);
+      }
+    }
+  }
+  void proof_delete(const Lit *begin, const Lit *end) {
+    if constexpr (Traits::proof) {
+      if (proof) {
+        proof->remove(begin, end);
+      }
+    }
+  }
+  void proof_add(std::initializer_list<Lit> lits) {
+    proof_add(lits.begin(), lits.end());
+  }
+  void proof_delete(std::initializer_list<Lit> lits) {
+    proof_delete(lits.begin(), lits.end());
+  }
+  void proof_delete(const ArenaClause &clause) {
+    proof_delete(clause.begin(), clause.end());
+  }
+  void proof_delete(const Clause &clause) {
+    proof_delete(clause.data(), clause.data() + clause.size());
+  }
+  // Log the top-level literals as units before deleting clauses that may be
+  // their reasons.
+  void proof_units() {
+    if constexpr (Traits::proof) {
+      if (!proof) {
+        return;
+      }
+      const size_t end = trail_lim.empty() ? trail.size() : trail_lim[0];
+      for (; proof_head < end; proof_head++) {
+        proof->add(&trail[proof_head], &trail[proof_head] + 1);
+      }
+    }
+  }
+  void clean_watchers() {
+    for (std::vector<Watcher> &watcher : watchers) {
+      watcher.erase(
+          std::remove_if(watcher.begin(), watcher.end(),
+                         [&](Watcher w) { return arena[w.cref].deleted(); }),
+          watcher.end());
+    }
+  }
+
+  // Remove duplicated and false literals of sorted literals in place.
+  // Return the new size or std::nullopt if the clause is satisfied.
+  [[nodiscard]] std::optional<size_t> filter_lits(Lit *ps, size_t size) const {
+    size_t new_len = 0;
+    for (size_t i = 0; i < size; i++) {
+      if (eval(ps[i]) == LitBool::True) {
+        return std::nullopt;
+      }
+      if (i >= 1) {
+        if (ps[i] == ~ps[i - 1]) {
+          return std::nullopt;
+        }
+        if (ps[i] == ps[i - 1]) {
+          continue;
+        }
+      }
+      if (eval(ps[i]) != LitBool::False) {
+        ps[new_len++] = ps[i];
+      }
+    }
+    return new_len;
+  }
+  // Add a clause whose literals are already filtered.
+  void add_filtered(const Lit *ps, size_t size) {
+    if (size == 0) {
+      inconsistent = true;
+    } else if (size == 1) {
+      // Unit Clause
+      enqueue(ps[0]);
+    } else if (size == 2) {
+      add_binary(ps[0], ps[1]);
+    } else {
+      attach_clause(arena.alloc(ps, size, false));
+    }
+  }
+  // Clauses can be added between solve() calls. It throws
+  // std::invalid_argument if a variable was eliminated.
+  void add_clause(Clause ps) {
+    assert(decision_level() == 0);
+    // grow the size
+    for (const Lit lit : ps) {
+      grow_vars(lit.vidx() + 1);
+      check_not_eliminated(lit);
+    }
+    std::sort(ps.begin(), ps.end());
+    if (std::optional<size_t> size = filter_lits(ps.data(), ps.size())) {
+      if (size.value() < ps.size()) {
+        proof_add(ps.data(), ps.data() + size.value());
+      }
+      add_filtered(ps.data(), size.value());
+    }
+  }
+  // Load a whole formula at the top level.
+  // The literal buffer is filtered in place, every structure is sized once
+  // from the clause and literal counts and the buffer is released after.
+  void load(CnfData &&cnf) {
+    assert(decision_level() == 0);
+    CnfData data = std::move(cnf);
+    std::vector<Lit> &lits = data.lits;
+    std::vector<size_t> &offsets = data.offsets;
+
+    size_t vars = data.var_num.value_or(0);
+    for (const Lit lit : lits) {
+      vars = std::max(vars, lit.vidx() + 1);
+    }
+    grow_vars(vars);
+
+    // Sort and filter each clause and move it to the front of the buffer.
+    std::vector<uint32_t> watch_counts(2 * num_vars(), 0);
+    std::vector<uint32_t> implication_counts(2 * num_vars(), 0);
+    size_t long_clauses = 0, arena_words = 0;
+    size_t num = 0, write = 0;
+    for (size_t i = 0; i + 1 < offsets.size(); i++) {
+      Lit *ps = lits.data() + offsets[i];
+      const size_t size = offsets[i + 1] - offsets[i];
+      std::sort(ps, ps + size);
+      const std::optional<size_t> new_size = filter_lits(ps, size);
+      if (!new_size.has_value()) {
+        continue;
+      }
+      if (new_size.value() < size) {
+        proof_add(ps, ps + new_size.value());
+      }
+      std::copy(ps, ps + new_size.value(), lits.data() + write);
+      ps = lits.data() + write;
+      offsets[num++] = write;
+      write += new_size.value();
+      if (new_size.value() == 2) {
+        implication_counts[(~ps[0]).lidx()]++;
+        implication_counts[(~ps[1]).lidx()]++;
+      } else if (new_size.value() > 2) {
+        watch_counts[(~ps[0]).lidx()]++;
+        watch_counts[(~ps[1]).lidx()]++;
+        long_clauses++;
+        arena_words += ClauseArena::words(new_size.value());
+      }
+    }
+    offsets[num] = write;
+
+    for (size_t i = 0; i < 2 * num_vars(); i++) {
+      watchers[i].reserve(watchers[i].size() + watch_counts[i]);
+      implications[i].reserve(implications[i].size() + implication_counts[i]);
+    }
+    arena.reserve(arena.size() + arena_words);
+    clauses.reserve(clauses.size() + long_clauses);
+
+    for (size_t i = 0; i < num && !inconsistent; i++) {
+      Lit *ps = lits.data() + offsets[i];
+      // unit clauses may have assigned some literals
+      if (std::optional<size_t> size =
+              filter_lits(ps, offsets[i + 1] - offsets[i])) {
+        if (size.value() < offsets[i + 1] - offsets[i]) {
+          proof_add(ps, ps + size.value());
+        }
+        add_filtered(ps, size.value());
+      }
+    }
+  }
+  // Load a formula shared with other solvers without modifying it.
+  // Each clause is sorted and filtered in a scratch buffer.
+  void load(const CnfData &cnf) {
+    assert(decision_level() == 0);
+    size_t vars = cnf.var_num.value_or(0);
+    for (const Lit lit : cnf.lits) {
+      vars = std::max(vars, lit.vidx() + 1);
+    }
+    grow_vars(vars);
+    Clause ps;
+    for (size_t i = 0; i < cnf.num_clauses() && !inconsistent; i++) {
+      ps.assign(cnf.lits.begin() + static_cast<std::ptrdiff_t>(cnf.offsets[i]),
+                cnf.lits.begin() +
+                    static_cast<std::ptrdiff_t>(cnf.offsets[i + 1]));
+      std::sort(ps.begin(), ps.end());
+      if (std::optional<size_t> size = filter_lits(ps.data(), ps.size())) {
+        if (size.value() < ps.size()) {
+          proof_add(ps.data(), ps.data() + size.value());
+        }
+        add_filtered(ps.data(), size.value());
+      }
+    }
+  }
+  // Propagate all binary implications of the queue first.
+  // Return a conflicting binary clause if any.
+  [[nodiscard]] std::optional<Conflict> propagate_binaries() {
+    while (binary_head < trail.size()) {
+      const Lit lit = trail[binary_head++];
+      ticks++;
+      for (const Lit implied : implications[lit.lidx()]) {
+        const LitBool value = eval(implied);
+        if (value == LitBool::True) {
+          continue;
+        }
+        if (value == LitBool::False) {
+          // (!lit v implied)
+          return Conflict(~lit, implied);
+        }
+        enqueue(implied, Reason::binary(~lit));
+      }
+    }
+    return std::nullopt;
+  }
+  [[nodiscard]] std::optional<Conflict> propagate() {
+    while (true) {
+      if (std::optional<Conflict> conflict = propagate_binaries()) {
+        return conflict;
+      }
+      if (que_head >= trail.size()) {
+        break;
+      }
+      const Lit lit = trail[que_head++];
+      const Lit nlit = ~lit;
+      propagations++;
+      ticks++;
+
+      std::vector<Watcher> &watcher = watchers[lit.lidx()];
+      for (size_t i = 0; i < watcher.size();) {
+        // Already satisfied by the blocker
+        if (eval(watcher[i].blocker) == LitBool::True) {
+          i++;
+          continue;
+        }
+        const CRef cr = watcher[i].cref;
+        const size_t next_idx = i + 1;
+        ArenaClause &clause = arena[cr];
+        ticks++;
+
+        assert(clause[0] == nlit || clause[1] == nlit);
+        // make sure that the clause[1] it false.
+        if (clause[0] == nlit) {
+          std::swap(clause[0], clause[1]);
+        }
+        assert(clause[1] == nlit && eval(clause[1]) == LitBool::False);
+
+        Lit first = clause[0];
+        // Already satisfied
+        if (first != watcher[i].blocker && eval(first) == LitBool::True) {
+          watcher[i].blocker = first;
+          i = next_idx;
+          goto nextclause;
+        }
+        // clause[0] is False or Undefine
+        // clause[1] is False
+        // clause[2..] is False or True or Undefine.
+
+        for (size_t k = 2; k < clause.size(); k++) {
+          // Found a new lit to watch
+          if (eval(clause[k]) != LitBool::False) {
+            std::swap(clause[1], clause[k]);
+            // Remove a value(swap the last one and pop back)
+            watcher[i] = watcher.back();
+            watcher.pop_back();
+            // New watch
+            watchers[(~clause[1]).lidx()].emplace_back(cr, first);
+            goto nextclause;
+          }
+        }
+
+        // clause[2..] is False
+        if (eval(first) == LitBool::False) {
+          // All literals are false
+          // Conflict
+          return Conflict(cr);
+        } else {
+          // All literals excepting first are false
+          // Unit Propagation
+          assert(eval(first) == LitBool::Undefine);
+          enqueue(first, Reason::clause(cr));
+          i = next_idx;
+        }
+      nextclause:;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // The false literals of the reason of an implied literal.
+  // `other` stores the literal of a binary reason.
+  [[nodiscard]] std::pair<const Lit *, const Lit *>
+  reason_lits(Reason reason, Lit &other) const {
+    if (reason.is_binary()) {
+      other = reason.lit();
+      return {&other, &other + 1};
+    }
+    const ArenaClause &clause = arena[reason.cref()];
+    return {clause.begin() + 1, clause.end()};
+  }
+  [[nodiscard]] uint32_t abstract_level(Var v) const {
+    return 1u << (vardata[static_cast<size_t>(v)].level & 31);
+  }
+  [[nodiscard]] std::pair<Clause, int> analyze(const Conflict &conflict) {
+    Clause learnt_clause;
+    assert([&]() {
+      bool ok = false;
+      for (const bool b : seen) {
+        ok |= b;
+      }
+      return !ok;
+    }());
+    const int conflicted_decision_level = decision_level();
+
+    int counter = 0;
+    {
+      if (!conflict.binary && arena[conflict.cref].learnt()) {
+        use_learnt(arena[conflict.cref]);
+      }
+      const Clause clause = lits(conflict);
+
+      // variables that are used to traverse by a conflicted clause
+      for (const Lit &lit : clause) {
+        assert(eval(lit) == LitBool::False);
+        // false at the top level forever
+        if (vardata[lit.vidx()].level == 0) {
+          continue;
+        }
+        seen[lit.vidx()] = true;
+        bump_var(lit.var());
+        if (vardata[lit.vidx()].level < conflicted_decision_level) {
+          learnt_clause.emplace_back(lit);
+        } else {
+          counter += 1;
+        }
+      }
+      assert(counter >= 1);
+    }
+
+    // traverse a implication graph to a 1-UIP(first-uinque-implication-point)
+    std::optional<Lit> first_uip = std::nullopt;
+    for (size_t i = trail.size() - 1; true; i--) {
+      Lit lit = trail[i];
+      // Skip a variable that isn't checked.
+      if (!seen[lit.vidx()]) {
+        continue;
+      }
+      counter--;
+      if (counter <= 0) {
+        // 1-UIP
+        first_uip = lit;
+        break;
+      }
+      seen[lit.vidx()] = false;
+
+      assert(vardata[lit.vidx()].reason.has_value());
+      const Reason reason = vardata[lit.vidx()].reason.value();
+      if (!reason.is_binary()) {
+        ArenaClause &clause = arena[reason.cref()];
+        assert(clause[0] == lit);
+        if (clause.learnt()) {
+          use_learnt(clause);
+        }
+      }
+      Lit other;
+      const auto [begin, end] = reason_lits(reason, other);
+      for (const Lit *it = begin; it != end; it++) {
+        Lit clit = *it;
+        // Already checked
+        if (seen[clit.vidx()] || vardata[clit.vidx()].level == 0) {
+          continue;
+        }
+        seen[clit.vidx()] = true;
+        bump_var(clit.var());
+        if (vardata[clit.vidx()].level < conflicted_decision_level) {
+          learnt_clause.push_back(clit);
+        } else {
+          counter += 1;
+        }
+      }
+    }
+    assert(first_uip.has_value());
+    // learnt_clause[0] = !first_uip
+    learnt_clause.push_back(~(first_uip.value()));
+    std::swap(learnt_clause[0], learnt_clause.back());
+
+    // Remove literals implied by the other literals of the clause.
+    analyze_toclear = learnt_clause;
+    uint32_t abstract_levels = 0;
+    for (size_t i = 1; i < learnt_clause.size(); i++) {
+      abstract_levels |= abstract_level(learnt_clause[i].var());
+    }
+    size_t new_size = 1;
+    for (size_t i = 1; i < learnt_clause.size(); i++) {
+      const Lit lit = learnt_clause[i];
+      if (!vardata[lit.vidx()].reason.has_value() ||
+          !lit_redundant(lit, abstract_levels)) {
+        learnt_clause[new_size++] = lit;
+      }
+    }
+    if constexpr (Traits::stats) {
+      statistics.minimized_literals += learnt_clause.size() - new_size;
+    }
+    learnt_clause.resize(new_size);
+    if (decision_kind() == DecisionKind::Lrb) {
+      lrb_bump_reason_side(learnt_clause);
+    }
+
+    // Back Jump
+    // learnt_clause[1] has the highest level to be watched after the jump.
+    int back_jump_level = 0;
+    for (size_t i = 1; i < learnt_clause.size(); i++) {
+      const int level = vardata[learnt_clause[i].vidx()].level;
+      if (level > back_jump_level) {
+        back_jump_level = level;
+        std::swap(learnt_clause[1], learnt_clause[i]);
+      }
+    }
+
+    for (const Lit &lit : analyze_toclear) {
+      seen[lit.vidx()] = false;
+    }
+
+    return std::make_pair(learnt_clause, back_jump_level);
+  }
+  // Whether a literal of a learnt clause is implied by the other literals.
+  // The implication graph is traversed from the literal until every path
+  // reaches a literal of the clause (seen) or the top level. Abstract levels
+  // filter out a path that reaches a level not in the clause early.
+  bool lit_redundant(Lit p, uint32_t abstract_levels) {
+    analyze_stack.clear();
+    analyze_stack.push_back(p);
+    const size_t top = analyze_toclear.size();
+    while (!analyze_stack.empty()) {
+      const Lit q = analyze_stack.back();
+      analyze_stack.pop_back();
+      assert(vardata[q.vidx()].reason.has_value());
+      Lit other;
+      const auto [begin, end] =
+          reason_lits(vardata[q.vidx()].reason.value(), other);
+      for (const Lit *it = begin; it != end; it++) {
+        const Lit lit = *it;
+        if (seen[lit.vidx()] || vardata[lit.vidx()].level == 0) {
+          continue;
+        }
+        if (vardata[lit.vidx()].reason.has_value() &&
+            (abstract_level(lit.var()) & abstract_levels) != 0) {
+          seen[lit.vidx()] = true;
+          analyze_stack.push_back(lit);
+          analyze_toclear.push_back(lit);
+        } else {
+          for (size_t i = top; i < analyze_toclear.size(); i++) {
+            seen[analyze_toclear[i].vidx()] = false;
+          }
+          analyze_toclear.resize(top);
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  // The number of distinct decision levels in literals.
+  [[nodiscard]] uint32_t compute_lbd(const Lit *begin, const Lit *end) {
+    lbd_stamp++;
+    uint32_t lbd = 0;
+    for (const Lit *it = begin; it != end; it++) {
+      const size_t level = static_cast<size_t>(vardata[it->vidx()].level);
+      if (level_stamps[level] != lbd_stamp) {
+        level_stamps[level] = lbd_stamp;
+        lbd++;
+      }
+    }
+    return lbd;
+  }
+  void clause_bump_activity(ArenaClause &clause) {
+    const float activity =
+        clause.activity() + static_cast<float>(clause_bump_inc);
+    clause.set_activity(activity);
+    if (activity > 1e20f) {
+      // rescale
+      for (const CRef cr : learnts) {
+        arena[cr].set_activity(arena[cr].activity() * 1e-20f);
+      }
+      clause_bump_inc *= 1e-20;
+    }
+  }
+  // A learnt clause takes part in conflict analysis.
+  // Its LBD can only improve because its literals are all assigned now.
+  void use_learnt(ArenaClause &clause) {
+    clause_bump_activity(clause);
+    clause.set_used(true);
+    if (clause.lbd() > CORE_LBD) {
+      const uint32_t lbd = compute_lbd(clause.begin(), clause.end());
+      if (lbd < clause.lbd()) {
+        clause.set_lbd(lbd);
+      }
+    }
+  }
+  bool locked(CRef cr) const {
+    const ArenaClause &clause = arena[cr];
+    // A clause is being propagated.
+    return eval(clause[0]) == LitBool::True &&
+           vardata[clause[0].vidx()].reason == Reason::clause(cr);
+  }
+  // Reduce the learnt clauses by tiers.
+  // core (LBD <= CORE_LBD) is kept forever and tier2 (LBD <= TIER2_LBD) is
+  // kept while it is used. The other clauses are the local tier and the less
+  // active half of them are removed.
+  void reduce_learnts() {
+    std::vector<CRef> local;
+    size_t new_size = 0;
+    for (const CRef cr : learnts) {
+      ArenaClause &clause = arena[cr];
+      const bool keep = clause.lbd() <= CORE_LBD ||
+                        (clause.lbd() <= TIER2_LBD && clause.used()) ||
+                        locked(cr);
+      clause.set_used(false);
+      if (keep) {
+        learnts[new_size++] = cr;
+      } else {
+        local.push_back(cr);
+      }
+    }
+    std::sort(local.begin(), local.end(), [&](CRef left, CRef right) {
+      return arena[left].activity() < arena[right].activity();
+    });
+    const size_t removed = local.size() / 2;
+    if constexpr (Traits::stats) {
+      statistics.reductions++;
+      statistics.reduced_learnts += removed;
+    }
+    for (size_t i = 0; i < local.size(); i++) {
+      if (i < removed) {
+        proof_delete(arena[local[i]]);
+        remove_clause(local[i]);
+      } else {
+        learnts[new_size++] = local[i];
+      }
+    }
+    learnts.resize(new_size);
+    clean_watchers();
+    check_garbage();
+  }
+
+  void simplify() {
+    assert(decision_level() == 0);
+    proof_units();
+    auto remove_satisfied = [&](std::vector<CRef> &cls) {
+      // learnts
+      size_t new_cls_size = 0;
+      for (size_t i = 0; i < cls.size(); i++) {
+        const CRef cr = cls[i];
+        const ArenaClause &clause = arena[cr];
+        bool satisfied = false;
+        for (size_t j = 0; j < clause.size(); j++) {
+          LitBool lb = eval(clause[j]);
+          if (lb == LitBool::True) {
+            proof_delete(clause);
+            remove_clause(cr);
+            satisfied = true;
+            break;
+          }
+        }
+
+        if (!satisfied) {
+          cls[new_cls_size] = cr;
+          new_cls_size++;
+        }
+      }
+      cls.resize(new_cls_size);
+    };
+
+    remove_satisfied(learnts);
+    remove_satisfied(clauses);
+    // (!lit v implied)
+    for (size_t idx = 0; idx < implications.size(); idx++) {
+      Lit lit;
+      lit.x = static_cast<int>(idx);
+      std::vector<Lit> &implication = implications[idx];
+      if (eval(~lit) == LitBool::True) {
+        for (const Lit implied : implication) {
+          // (!lit v implied) appears twice
+          if (~lit < implied) {
+            proof_delete({~lit, implied});
+          }
+        }
+        implication.clear();
+        continue;
+      }
+      implication.erase(std::remove_if(implication.begin(), implication.end(),
+                                       [&](Lit implied) {
+                                         if (eval(implied) != LitBool::True) {
+                                           return false;
+                                         }
+                                         if (~lit < implied) {
+                                           proof_delete({~lit, implied});
+                                         }
+                                         return true;
+                                       }),
+                        implication.end());
+    }
+    clean_watchers();
+    check_garbage();
+  }
+  // Compact the arena when enough of it is occupied by deleted clauses.
+  void check_garbage() {
+    if (static_cast<double>(arena.wasted()) >
+        static_cast<double>(arena.size()) * GARBAGE_FRACTION) {
+      garbage_collect();
+    }
+  }
+  void garbage_collect() {
+    ClauseArena to;
+    to.reserve(arena.size() - arena.wasted());
+    // Watchers are already cleaned, so every clause they refer to is alive.
+    // Relocating in watcher order keeps clauses that are propagated together
+    // close to each other.
+    for (std::vector<Watcher> &watcher : watchers) {
+      for (Watcher &w : watcher) {
+        arena.reloc(w.cref, to);
+      }
+    }
+    for (const Lit lit : trail) {
+      std::optional<Reason> &reason = vardata[lit.vidx()].reason;
+      if (!reason.has_value() || reason.value().is_binary()) {
+        continue;
+      }
+      CRef cr = reason.value().cref();
+      if (arena[cr].deleted()) {
+        reason = std::nullopt;
+      } else {
+        arena.reloc(cr, to);
+        reason = Reason::clause(cr);
+      }
+    }
+    for (CRef &cr : learnts) {
+      arena.reloc(cr, to);
+    }
+    for (CRef &cr : clauses) {
+      arena.reloc(cr, to);
+    }
+    arena = std::move(to);
+  }
+  // Keep a variable in the formula, e.g. to add clauses with it or assume it
+  // after preprocessing. It must be frozen before the solve() that
+  // preprocesses.
+  void freeze(Var v) {
+    grow_vars(static_cast<size_t>(v) + 1);
+    frozen[static_cast<size_t>(v)] = true;
+  }
+  [[nodiscard]] bool is_eliminated(Var v) const {
+    return eliminated[static_cast<size_t>(v)];
+  }
+  // An eliminated variable is gone from the formula and a clause or an
+  // assumption with it would be solved wrong.
+  void check_not_eliminated(Lit lit) const {
+    if (eliminated[lit.vidx()]) {
+      throw std::invalid_argument("variable " +
+                                  std::to_string(lit.vidx() + 1) +
+                                  " is eliminated; freeze it before solve()");
+    }
+  }
+  // Replace the irredundant clauses with the result of Eliminator at the top
+  // level. Learnt clauses may contain eliminated variables and are removed.
+  void preprocess() {
+    assert(decision_level() == 0);
+    if (propagate()) {
+      inconsistent = true;
+      return;
+    }
+    proof_units();
+    Eliminator eliminator(num_vars(), frozen,
+                          Traits::proof ? proof : nullptr);
+    auto add = [&](const Lit *begin, const Lit *end) {
+      Clause clause;
+      for (const Lit *it = begin; it != end; it++) {
+        const LitBool value = eval(*it);
+        if (value == LitBool::True) {
+          proof_delete(begin, end);
+          return;
+        }
+        if (value == LitBool::Undefine) {
+          clause.push_back(*it);
+        }
+      }
+      if (clause.size() < static_cast<size_t>(end - begin)) {
+        proof_add(clause.data(), clause.data() + clause.size());
+        proof_delete(begin, end);
+      }
+      eliminator.add_clause(std::move(clause));
+    };
+    for (const CRef cr : clauses) {
+      add(arena[cr].begin(), arena[cr].end());
+      remove_clause(cr);
+    }
+    for (const CRef cr : learnts) {
+      proof_delete(arena[cr]);
+      remove_clause(cr);
+    }
+    clauses.clear();
+    learnts.clear();
+    clean_watchers();
+    for (size_t idx = 0; idx < implications.size(); idx++) {
+      Lit lit;
+      lit.x = static_cast<int>(idx);
+      for (const Lit implied : implications[idx]) {
+        // (!lit v implied) appears twice
+        if (~lit < implied) {
+          const Lit binary[2] = {~lit, implied};
+          add(binary, binary + 2);
+        }
+      }
+      implications[idx].clear();
+    }
+    // only the top level is on the trail
+    for (const Lit lit : trail) {
+      vardata[lit.vidx()].reason = std::nullopt;
+    }
+
+    if (!eliminator.run(PREPROCESS_STEPS)) {
+      inconsistent = true;
+      return;
+    }
+    for (const Lit lit : eliminator.units()) {
+      if (eval(lit) == LitBool::Undefine) {
+        enqueue(lit);
+      }
+    }
+    const std::vector<bool> &vars = eliminator.eliminated_vars();
+    for (size_t v = 0; v < vars.size(); v++) {
+      eliminated[v] = eliminated[v] || vars[v];
+    }
+    const std::vector<Lit> &lits = eliminator.eliminated_lits();
+    const std::vector<size_t> &offsets = eliminator.eliminated_offsets();
+    for (size_t i = 0; i + 1 < offsets.size(); i++) {
+      elim_lits.insert(elim_lits.end(), lits.begin() + long(offsets[i]),
+                       lits.begin() + long(offsets[i + 1]));
+      elim_offsets.push_back(elim_lits.size());
+    }
+    for (Clause &clause : eliminator.clauses()) {
+      add_clause(std::move(clause));
+    }
+    garbage_collect();
+  }
+  // Assign the eliminated variables in the reverse order of elimination so
+  // that each of their clauses is satisfied.
+  void extend_model() {
+    for (size_t i = elim_offsets.size() - 1; i-- > 0;) {
+      bool satisfied = false;
+      for (size_t j = elim_offsets[i]; j < elim_offsets[i + 1]; j++) {
+        const Lit lit = elim_lits[j];
+        if (model[lit.vidx()] == lit.pos()) {
+          satisfied = true;
+          break;
+        }
+      }
+      if (!satisfied) {
+        const Lit pivot = elim_lits[elim_offsets[i]];
+        model[pivot.vidx()] = pivot.pos();
+      }
+    }
+  }
+  // Inprocessing at the top level: failed literal probing, equivalent
+  // literal substitution and vivification.
+  void inprocess() {
+    assert(decision_level() == 0);
+    inprocessings++;
+    next_inprocess = conflicts + INPROCESS_INTERVAL * (inprocessings + 1);
+    // backtracking from probes must not overwrite the saved phases
+    const std::vector<bool> saved_phases = phases;
+    if (options.inprocess) {
+      probe();
+      if (!inconsistent) {
+        substitute_equivalences();
+      }
+    }
+    if (options.vivify && !inconsistent) {
+      vivify();
+    }
+    phases = saved_phases;
+    if (!inconsistent) {
+      simplify();
+    }
+    inprocess_ticks = ticks;
+  }
+  // Assign each root of the binary implication graph and propagate.
+  // If it fails, its negation is a unit. Literals implied by both a literal
+  // and its negation are units too.
+  void probe() {
+    const uint64_t search_ticks = ticks - inprocess_ticks;
+    const uint64_t limit =
+        ticks + std::max(PROBE_MIN_TICKS, search_ticks / PROBE_RATIO);
+    std::vector<uint32_t> stamps(values.size(), 0);
+    uint32_t stamp = 0;
+    for (size_t idx = 0; idx < values.size() && ticks < limit; idx++) {
+      Lit lit;
+      lit.x = static_cast<int>(idx);
+      // roots: no binary clause implies lit
+      if (eval(lit) != LitBool::Undefine || eliminated[lit.vidx()] ||
+          implications[idx].empty() || !implications[(~lit).lidx()].empty()) {
+        continue;
+      }
+      // implied by lit
+      stamp++;
+      if (probe_lit(lit, stamps, stamp, false) &&
+          eval(lit) == LitBool::Undefine) {
+        // implied by both lit and its negation
+        probe_lit(~lit, stamps, stamp, true);
+      }
+      if (inconsistent) {
+        return;
+      }
+    }
+  }
+  // Propagate lit at a new level. It stamps the implied literals or, with
+  // `common`, enqueues stamped ones at the top level.
+  // Return false if lit fails and its negation is a unit.
+  bool probe_lit(Lit lit, std::vector<uint32_t> &stamps, uint32_t stamp,
+                 bool common) {
+    new_decision(lit);
+    if (propagate()) {
+      pop_queue_until(0);
+      proof_add({~lit});
+      enqueue(~lit);
+      inconsistent = propagate().has_value();
+      return false;
+    }
+    std::vector<Lit> units;
+    for (size_t i = trail_lim[0] + 1; i < trail.size(); i++) {
+      const Lit implied = trail[i];
+      if (!common) {
+        stamps[implied.lidx()] = stamp;
+      } else if (stamps[implied.lidx()] == stamp) {
+        units.push_back(implied);
+      }
+    }
+    pop_queue_until(0);
+    for (const Lit unit : units) {
+      if (eval(unit) == LitBool::Undefine) {
+        // implied by ~lit in the first probe
+        proof_add({lit, unit});
+        proof_add({unit});
+        proof_delete({lit, unit});
+        enqueue(unit);
+      }
+    }
+    if (!units.empty()) {
+      inconsistent = propagate().has_value();
+    }
+    return true;
+  }
+  // Strongly connected components of the binary implication graph are
+  // equivalent literals. Return the representative of each literal or
+  // std::nullopt if a literal is equivalent to its negation.
+  std::optional<std::vector<Lit>> equivalent_literals() {
+    const size_t n = values.size();
+    std::vector<Lit> repr(n);
+    for (size_t idx = 0; idx < n; idx++) {
+      repr[idx].x = static_cast<int>(idx);
+    }
+    // Tarjan's algorithm without recursion
+    std::vector<uint32_t> index(n, 0), low(n, 0);
+    std::vector<bool> on_stack(n, false), done(n, false);
+    std::vector<Lit> stack, component;
+    // (literal, the next implication to visit)
+    std::vector<std::pair<Lit, size_t>> work;
+    uint32_t counter = 0;
+    auto visit = [&](Lit lit) {
+      index[lit.lidx()] = low[lit.lidx()] = ++counter;
+      stack.push_back(lit);
+      on_stack[lit.lidx()] = true;
+      work.emplace_back(lit, 0);
+    };
+    for (size_t root = 0; root < n; root++) {
+      Lit lit;
+      lit.x = static_cast<int>(root);
+      if (index[root] != 0 || eval(lit) != LitBool::Undefine ||
+          eliminated[lit.vidx()]) {
+        continue;
+      }
+      visit(lit);
+      while (!work.empty()) {
+        const Lit from = work.back().first;
+        const std::vector<Lit> &implied = implications[from.lidx()];
+        if (work.back().second < implied.size()) {
+          const Lit to = implied[work.back().second++];
+          if (eval(to) != LitBool::Undefine) {
+            continue;
+          }
+          if (index[to.lidx()] == 0) {
+            visit(to);
+          } else if (on_stack[to.lidx()]) {
+            low[from.lidx()] = std::min(low[from.lidx()], index[to.lidx()]);
+          }
+          continue;
+        }
+        work.pop_back();
+        if (!work.empty()) {
+          const size_t parent = work.back().first.lidx();
+          low[parent] = std::min(low[parent], low[from.lidx()]);
+        }
+        if (low[from.lidx()] != index[from.lidx()]) {
+          continue;
+        }
+        component.clear();
+        while (true) {
+          const Lit top = stack.back();
+          stack.pop_back();
+          on_stack[top.lidx()] = false;
+          component.push_back(top);
+          if (top == from) {
+            break;
+          }
+        }
+        // The complement component has the complement representatives.
+        if (component.size() == 1 || done[component[0].lidx()]) {
+          continue;
+        }
+        Lit r = component[0];
+        for (const Lit member : component) {
+          if (done[(~member).lidx()]) {
+            return std::nullopt;
+          }
+          done[member.lidx()] = true;
+          if (frozen[member.vidx()]) {
+            r = member;
+          } else if (!frozen[r.vidx()] && member < r) {
+            r = member;
+          }
+        }
+        for (const Lit member : component) {
+          done[(~member).lidx()] = true;
+          // frozen variables are kept with their binary clauses
+          if (!frozen[member.vidx()]) {
+            repr[member.lidx()] = r;
+            repr[(~member).lidx()] = ~r;
+          }
+        }
+      }
+    }
+    return repr;
+  }
+  // Add a clause rewritten at the top level. A long clause is watched and
+  // appended to `to`.
+  void add_rewritten(Clause &clause, bool learnt, uint32_t lbd,
+                     std::vector<CRef> &to) {
+    std::sort(clause.begin(), clause.end());
+    const std::optional<size_t> size =
+        filter_lits(clause.data(), clause.size());
+    if (!size) {
+      return;
+    }
+    proof_add(clause.data(), clause.data() + size.value());
+    if (size.value() == 0) {
+      inconsistent = true;
+    } else if (size.value() == 1) {
+      enqueue(clause[0]);
+    } else if (size.value() == 2) {
+      add_binary(clause[0], clause[1]);
+    } else {
+      const CRef cr = arena.alloc(clause.data(), size.value(), learnt);
+      arena[cr].set_lbd(std::min(lbd, static_cast<uint32_t>(size.value())));
+      watch_clause(cr);
+      to.push_back(cr);
+    }
+  }
+  // Replace equivalent literals with their representatives in every clause.
+  void substitute_equivalences() {
+    const std::optional<std::vector<Lit>> found = equivalent_literals();
+    if (!found) {
+      inconsistent = true;
+      return;
+    }
+    const std::vector<Lit> &repr = found.value();
+    size_t substituted = 0;
+    for (size_t v = 0; v < num_vars(); v++) {
+      const Lit lit = Lit(Var(v), true);
+      const Lit r = repr[lit.lidx()];
+      if (r == lit) {
+        continue;
+      }
+      // v = r
+      for (const Lit pivot : {lit, ~lit}) {
+        elim_lits.push_back(pivot);
+        elim_lits.push_back(pivot == lit ? ~r : r);
+        elim_offsets.push_back(elim_lits.size());
+      }
+      eliminated[v] = true;
+      substituted++;
+    }
+    if (substituted == 0) {
+      return;
+    }
+    proof_units();
+
+    // The rewritten clauses follow from the binary clauses of the
+    // equivalences, so the replaced binary clauses are deleted last.
+    std::vector<Clause> unchanged, binaries, replaced;
+    for (size_t idx = 0; idx < implications.size(); idx++) {
+      Lit lit;
+      lit.x = static_cast<int>(idx);
+      for (const Lit implied : implications[idx]) {
+        // (!lit v implied) appears twice
+        if (!(~lit < implied)) {
+          continue;
+        }
+        Clause mapped = {repr[(~lit).lidx()], repr[implied.lidx()]};
+        std::sort(mapped.begin(), mapped.end());
+        if (mapped[0] == ~lit && mapped[1] == implied) {
+          unchanged.push_back(std::move(mapped));
+        } else {
+          binaries.push_back(std::move(mapped));
+          replaced.push_back({~lit, implied});
+        }
+      }
+      implications[idx].clear();
+    }
+    for (std::vector<Clause> *list : {&unchanged, &binaries}) {
+      std::sort(list->begin(), list->end());
+      list->erase(std::unique(list->begin(), list->end()), list->end());
+    }
+    for (const Clause &binary : unchanged) {
+      add_binary(binary[0], binary[1]);
+    }
+    std::vector<CRef> rewritten;
+    for (Clause &binary : binaries) {
+      if (!std::binary_search(unchanged.begin(), unchanged.end(), binary)) {
+        add_rewritten(binary, false, 0, rewritten);
+      }
+    }
+    for (std::vector<CRef> *crs : {&clauses, &learnts}) {
+      rewritten.clear();
+      size_t kept = 0;
+      for (const CRef cr : *crs) {
+        const ArenaClause &clause = arena[cr];
+        Clause mapped;
+        bool changed = false;
+        for (const Lit lit : clause) {
+          mapped.push_back(repr[lit.lidx()]);
+          changed |= mapped.back() != lit;
+        }
+        if (!changed) {
+          (*crs)[kept++] = cr;
+          continue;
+        }
+        const bool learnt = clause.learnt();
+        const uint32_t lbd = clause.lbd();
+        add_rewritten(mapped, learnt, lbd, rewritten);
+        proof_delete(arena[cr]);
+        remove_clause(cr);
+      }
+      crs->resize(kept);
+      crs->insert(crs->end(), rewritten.begin(), rewritten.end());
+    }
+    for (const Clause &binary : replaced) {
+      proof_delete(binary);
+    }
+    clean_watchers();
+    if (!inconsistent) {
+      inconsistent = propagate().has_value();
+    }
+  }
+  // Vivification: assign the negations of the literals of a clause one by
+  // one. If a literal becomes true or a conflict occurs, the clause is
+  // shortened to the literals whose negations lead to it.
+  // Low-LBD learnt clauses are tried first, then the irredundant clauses.
+  void vivify() {
+    assert(decision_level() == 0);
+    if (propagate()) {
+      inconsistent = true;
+      return;
+    }
+    const uint64_t search_ticks = ticks - inprocess_ticks;
+    const uint64_t limit =
+        ticks + std::max(VIVIFY_MIN_TICKS, search_ticks / VIVIFY_RATIO);
+    std::vector<CRef> candidates;
+    for (const CRef cr : learnts) {
+      if (arena[cr].lbd() <= TIER2_LBD && !arena[cr].vivified()) {
+        candidates.push_back(cr);
+      }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [&](CRef left, CRef right) {
+                       return arena[left].lbd() < arena[right].lbd();
+                     });
+    for (const CRef cr : clauses) {
+      if (!arena[cr].vivified()) {
+        candidates.push_back(cr);
+      }
+    }
+
+    std::vector<CRef> added_learnts, added_clauses;
+    Clause shortened;
+    for (const CRef cr : candidates) {
+      if (ticks >= limit || inconsistent) {
+        break;
+      }
+      if (!vivify_clause(cr, shortened)) {
+        continue;
+      }
+      const bool learnt = arena[cr].learnt();
+      const uint32_t lbd = arena[cr].lbd();
+      add_rewritten(shortened, learnt, lbd,
+                    learnt ? added_learnts : added_clauses);
+      proof_delete(arena[cr]);
+      remove_clause(cr);
+      if (!inconsistent) {
+        inconsistent = propagate().has_value();
+      }
+    }
+    for (auto [crs, added] : {std::make_pair(&learnts, &added_learnts),
+                              std::make_pair(&clauses, &added_clauses)}) {
+      crs->erase(std::remove_if(crs->begin(), crs->end(),
+                                [&](CRef cr) { return arena[cr].deleted(); }),
+                 crs->end());
+      crs->insert(crs->end(), added->begin(), added->end());
+    }
+    clean_watchers();
+  }
+  // Return true if the clause is shortened and store the result in
+  // `shortened`.
+  bool vivify_clause(CRef cr, Clause &shortened) {
+    arena[cr].set_vivified(true);
+    // propagation reorders the literals
+    const Clause original(arena[cr].begin(), arena[cr].end());
+    for (const Lit lit : original) {
+      if (eval(lit) == LitBool::True) {
+        // satisfied at the top level
+        return false;
+      }
+    }
+    shortened.clear();
+    bool reached = false;
+    for (const Lit lit : original) {
+      const LitBool value = eval(lit);
+      if (value == LitBool::True) {
+        // implied by the negations of the decided literals
+        seen[lit.vidx()] = true;
+        shortened.push_back(lit);
+        reached = true;
+        break;
+      }
+      if (value == LitBool::False) {
+        continue;
+      }
+      new_decision(~lit);
+      if (std::optional<Conflict> conflict = propagate()) {
+        for (const Lit false_lit : lits(conflict.value())) {
+          seen[false_lit.vidx()] = vardata[false_lit.vidx()].level > 0;
+        }
+        reached = true;
+        break;
+      }
+    }
+    if (decision_level() == 0) {
+      // every literal is false at the top level
+      return false;
+    }
+    if (reached) {
+      std::vector<Lit> decisions;
+      seen_decisions(decisions);
+      for (const Lit decision : decisions) {
+        shortened.push_back(~decision);
+      }
+    } else {
+      // The literals that are false before their turn are dropped.
+      for (const size_t lim : trail_lim) {
+        shortened.push_back(~trail[lim]);
+      }
+    }
+    pop_queue_until(0);
+    return shortened.size() < original.size();
+  }
+  // Exchange learnt clauses with the other solvers of `exchange` as the
+  // id-th one.
+  void share(ClauseExchange *to, size_t id) {
+    exchange = to;
+    share_id = id;
+    share_cursors.assign(to->size(), 0);
+  }
+  [[nodiscard]] static uint64_t clause_hash(const Clause &sorted) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const Lit lit : sorted) {
+      hash = (hash ^ static_cast<uint64_t>(lit.x)) * 0x100000001b3ull;
+    }
+    return hash;
+  }
+  // Export units, binaries and learnt clauses with LBD <= share_lbd.
+  // share_lbd is adjusted so that about SHARE_TARGET clauses are exported
+  // every SHARE_ADJUST_INTERVAL conflicts.
+  void export_learnt(const Clause &clause, uint32_t lbd) {
+    if (conflicts >= next_share_adjust) {
+      next_share_adjust = conflicts + SHARE_ADJUST_INTERVAL;
+      if (share_recent > SHARE_TARGET && share_lbd > 1) {
+        share_lbd--;
+      } else if (share_recent < SHARE_TARGET / 2 && share_lbd < TIER2_LBD) {
+        share_lbd++;
+      }
+      share_recent = 0;
+    }
+    if (clause.size() > SharedRing::MAX_SIZE ||
+        (clause.size() > 2 && lbd > share_lbd)) {
+      return;
+    }
+    share_buffer = clause;
+    std::sort(share_buffer.begin(), share_buffer.end());
+    if (!shared_hashes.insert(clause_hash(share_buffer)).second) {
+      return;
+    }
+    exchange->ring(share_id).push(share_buffer.data(), share_buffer.size(),
+                                  lbd);
+    exported++;
+    share_recent++;
+  }
+  // Add the clauses exported by the other solvers at the top level.
+  // Clauses with variables eliminated here are skipped.
+  void import_shared() {
+    assert(decision_level() == 0);
+    for (size_t from = 0; from < exchange->size(); from++) {
+      if (from == share_id) {
+        continue;
+      }
+      exchange->ring(from).read(
+          share_cursors[from], share_buffer, [&](Clause &clause, uint32_t lbd) {
+            if (inconsistent) {
+              return;
+            }
+            for (const Lit lit : clause) {
+              if (lit.vidx() >= num_vars() || eliminated[lit.vidx()]) {
+                return;
+              }
+            }
+            if (!shared_hashes.insert(clause_hash(clause)).second) {
+              return;
+            }
+            imported++;
+            if (clause.size() == 1) {
+              skip_simplify = false;
+            }
+            add_rewritten(clause, true, lbd, learnts);
+          });
+    }
+    if (!inconsistent && propagate()) {
+      inconsistent = true;
+    }
+  }
+  [[nodiscard]] uint64_t num_exported() const { return exported; }
+  [[nodiscard]] uint64_t num_imported() const { return imported; }
+  // Called at the top level after each restart, before the shared clauses
+  // are imported, if the solver shares clauses. It can move clauses between
+  // the ClauseExchange and other processes without cutting the search off.
+  std::function<void()> on_share;
+  // Cube generation
+  // Split the formula under `prefix` into cubes of at most `depth` more
+  // literals chosen by lookahead. Cubes refuted by propagation are dropped,
+  // so no cubes means that the prefix is unsatisfiable.
+  std::vector<Clause> cubes(const Clause &prefix, size_t depth) {
+    assert(decision_level() == 0);
+    std::vector<Clause> result;
+    if (inconsistent || propagate()) {
+      inconsistent = true;
+      return result;
+    }
+    // the number of clauses of each variable
+    std::vector<size_t> occurs(num_vars(), 0);
+    for (const CRef cr : clauses) {
+      for (const Lit lit : arena[cr]) {
+        occurs[lit.vidx()]++;
+      }
+    }
+    for (size_t idx = 0; idx < implications.size(); idx++) {
+      occurs[idx >> 1] += implications[idx].size();
+    }
+    Clause cube;
+    bool refuted = false;
+    for (const Lit lit : prefix) {
+      cube.push_back(lit);
+      const LitBool value = eval(lit);
+      if (value == LitBool::False) {
+        refuted = true;
+        break;
+      }
+      if (value == LitBool::Undefine) {
+        new_decision(lit);
+        if (propagate()) {
+          refuted = true;
+          break;
+        }
+      }
+    }
+    if (!refuted) {
+      split(cube, depth, occurs, result);
+    }
+    pop_queue_until(0);
+    return result;
+  }
+  void split(Clause &cube, size_t depth, const std::vector<size_t> &occurs,
+             std::vector<Clause> &result) {
+    if (depth == 0) {
+      result.push_back(cube);
+      return;
+    }
+    bool failed = false;
+    const std::optional<Lit> branch = lookahead(occurs, failed);
+    if (failed) {
+      return;
+    }
+    if (!branch) {
+      // every variable is assigned
+      result.push_back(cube);
+      return;
+    }
+    const int level = decision_level();
+    for (const Lit lit : {branch.value(), ~branch.value()}) {
+      new_decision(lit);
+      if (!propagate()) {
+        cube.push_back(lit);
+        split(cube, depth - 1, occurs, result);
+        cube.pop_back();
+      }
+      pop_queue_until(level);
+    }
+  }
+  // Propagate both literals of the unassigned variables with the most
+  // occurrences and return the literal of the variable with the best score
+  // pos * neg + pos + neg, where pos and neg are the numbers of literals
+  // their propagation assigns. A failed literal is negated at the current
+  // level. `failed` is set if the current level fails.
+  std::optional<Lit> lookahead(const std::vector<size_t> &occurs,
+                               bool &failed) {
+    std::vector<Var> candidates;
+    for (size_t v = 0; v < num_vars(); v++) {
+      if (eval(Lit(Var(v), true)) == LitBool::Undefine && !eliminated[v]) {
+        candidates.push_back(Var(v));
+      }
+    }
+    const size_t size = std::min(candidates.size(), LOOKAHEAD_CANDIDATES);
+    std::partial_sort(candidates.begin(), candidates.begin() + long(size),
+                      candidates.end(), [&](Var a, Var b) {
+                        return occurs[static_cast<size_t>(a)] >
+                               occurs[static_cast<size_t>(b)];
+                      });
+    candidates.resize(size);
+
+    const int level = decision_level();
+    std::optional<Lit> best;
+    uint64_t best_score = 0;
+    for (const Var v : candidates) {
+      if (eval(Lit(v, true)) != LitBool::Undefine) {
+        // forced by a failed literal
+        continue;
+      }
+      size_t counts[2] = {0, 0};
+      for (const bool positive : {true, false}) {
+        const Lit lit = Lit(v, positive);
+        const size_t before = trail.size();
+        new_decision(lit);
+        const bool conflict = propagate().has_value();
+        counts[positive] = trail.size() - before;
+        pop_queue_until(level);
+        if (conflict) {
+          if (level == 0) {
+            proof_add({~lit});
+          }
+          enqueue(~lit);
+          if (propagate()) {
+            failed = true;
+            inconsistent = level == 0;
+            return std::nullopt;
+          }
+          break;
+        }
+      }
+      if (eval(Lit(v, true)) != LitBool::Undefine) {
+        continue;
+      }
+      const uint64_t score = counts[0] * counts[1] + counts[0] + counts[1];
+      if (!best || score > best_score) {
+        best = Lit(v, counts[1] >= counts[0]);
+        best_score = score;
+      }
+    }
+    if (best && eval(best.value()) != LitBool::Undefine) {
+      // assigned by a later failed literal
+      return lookahead(occurs, failed);
+    }
+    return best;
+  }
+  // Phase
+  [[nodiscard]] bool decide_phase(Var v) const {
+    const size_t idx = static_cast<size_t>(v);
+    if (stable && options.target_phase && target_phases[idx] != 0) {
+      return target_phases[idx] > 0;
+    }
+    return phases[idx];
+  }
+  // The first `assigned` literals of the trail are conflict-free.
+  // Remember the longest such assignment since the last rephase (target) and
+  // ever (best).
+  void update_target_and_best(size_t assigned) {
+    if (assigned > target_assigned) {
+      copy_phases(target_phases, assigned);
+      target_assigned = assigned;
+    }
+    if (assigned > best_assigned) {
+      copy_phases(best_phases, assigned);
+      best_assigned = assigned;
+    }
+  }
+  void copy_phases(std::vector<int8_t> &to, size_t assigned) const {
+    for (size_t i = 0; i < assigned; i++) {
+      to[trail[i].vidx()] = trail[i].pos() ? 1 : -1;
+    }
+  }
+  // Reset the saved phases by the rephasing schedule:
+  // original, inverted, then (best, walk, best, random, best, original, best,
+  // inverted) repeatedly.
+  void rephase() {
+    static constexpr Rephase SCHEDULE[] = {
+        Rephase::Best, Rephase::Walk,     Rephase::Best, Rephase::Random,
+        Rephase::Best, Rephase::Original, Rephase::Best, Rephase::Inverted};
+    constexpr size_t SCHEDULE_SIZE = sizeof(SCHEDULE) / sizeof(SCHEDULE[0]);
+    Rephase kind = Rephase::Original;
+    if (rephases == 1) {
+      kind = Rephase::Inverted;
+    } else if (rephases >= 2) {
+      kind = SCHEDULE[(rephases - 2) % SCHEDULE_SIZE];
+    }
+    rephases++;
+    next_rephase = conflicts + REPHASE_INTERVAL * rephases;
+
+    switch (kind) {
+    case Rephase::Original:
+      std::fill(phases.begin(), phases.end(), options.initial_phase);
+      break;
+    case Rephase::Inverted:
+      std::fill(phases.begin(), phases.end(), !options.initial_phase);
+      break;
+    case Rephase::Best:
+      for (size_t i = 0; i < num_vars(); i++) {
+        if (best_phases[i] != 0) {
+          phases[i] = best_phases[i] > 0;
+        }
+      }
+      best_assigned = 0;
+      break;
+    case Rephase::Walk:
+      walk();
+      break;
+    case Rephase::Random:
+      for (size_t i = 0; i < num_vars(); i++) {
+        phases[i] = rng.next() & 1;
+      }
+      break;
+    }
+    std::fill(target_phases.begin(), target_phases.end(), 0);
+    target_assigned = 0;
+  }
+  // ProbSAT local search over the irredundant clauses from the saved phases.
+  // The assignment with the fewest unsatisfied clauses becomes the saved
+  // phases.
+  void walk() {
+    assert(decision_level() == 0);
+    // clauses without the top level literals
+    std::vector<Lit> lits;
+    std::vector<size_t> offsets = {0};
+    auto add = [&](const Lit *begin, const Lit *end) {
+      const size_t start = lits.size();
+      for (const Lit *it = begin; it != end; it++) {
+        const LitBool value = eval(*it);
+        if (value == LitBool::True) {
+          lits.resize(start);
+          return;
+        }
+        if (value == LitBool::Undefine) {
+          lits.push_back(*it);
+        }
+      }
+      if (lits.size() > start) {
+        offsets.push_back(lits.size());
+      }
+    };
+    for (const CRef cr : clauses) {
+      add(arena[cr].begin(), arena[cr].end());
+    }
+    for (size_t idx = 0; idx < implications.size(); idx++) {
+      Lit lit;
+      lit.x = static_cast<int>(idx);
+      for (const Lit implied : implications[idx]) {
+        // (!lit v implied) appears twice
+        if (~lit < implied) {
+          const Lit binary[2] = {~lit, implied};
+          add(binary, binary + 2);
+        }
+      }
+    }
+    const size_t n = offsets.size() - 1;
+    if (n == 0) {
+      return;
+    }
+
+    std::vector<std::vector<uint32_t>> occurs(2 * num_vars());
+    for (size_t c = 0; c < n; c++) {
+      for (size_t i = offsets[c]; i < offsets[c + 1]; i++) {
+        occurs[lits[i].lidx()].push_back(static_cast<uint32_t>(c));
+      }
+    }
+    std::vector<bool> value = phases;
+    auto is_true = [&](Lit lit) { return value[lit.vidx()] == lit.pos(); };
+    std::vector<uint32_t> true_count(n, 0);
+    std::vector<uint32_t> unsat;
+    // clause -> the position in unsat
+    std::vector<size_t> unsat_pos(n, 0);
+    for (size_t c = 0; c < n; c++) {
+      for (size_t i = offsets[c]; i < offsets[c + 1]; i++) {
+        true_count[c] += is_true(lits[i]);
+      }
+      if (true_count[c] == 0) {
+        unsat_pos[c] = unsat.size();
+        unsat.push_back(static_cast<uint32_t>(c));
+      }
+    }
+    std::vector<bool> best = value;
+    size_t best_unsat = unsat.size();
+
+    // weight by the number of clauses broken by a flip: (1 + break)^-cb
+    std::vector<double> weights(WALK_MAX_BREAK + 1);
+    for (size_t b = 0; b <= WALK_MAX_BREAK; b++) {
+      weights[b] = std::pow(1.0 + static_cast<double>(b), -WALK_CB);
+    }
+    std::vector<double> scores;
+    const uint64_t flips = std::min<uint64_t>(WALK_MAX_FLIPS, WALK_FLIPS * n);
+    for (uint64_t step = 0; step < flips && !unsat.empty(); step++) {
+      const uint32_t c = unsat[rng.below(unsat.size())];
+      scores.clear();
+      double sum = 0.0;
+      for (size_t i = offsets[c]; i < offsets[c + 1]; i++) {
+        size_t breaks = 0;
+        for (const uint32_t d : occurs[(~lits[i]).lidx()]) {
+          breaks += true_count[d] == 1;
+        }
+        scores.push_back(weights[std::min(breaks, WALK_MAX_BREAK)]);
+        sum += scores.back();
+      }
+      double r = rng.real() * sum;
+      size_t pick = offsets[c];
+      for (size_t i = 0; i + 1 < scores.size() && r >= scores[i]; i++) {
+        r -= scores[i];
+        pick++;
+      }
+
+      // flip
+      const Lit lit = lits[pick];
+      value[lit.vidx()] = lit.pos();
+      for (const uint32_t d : occurs[lit.lidx()]) {
+        if (true_count[d]++ == 0) {
+          // satisfied
+          const uint32_t last = unsat.back();
+          unsat[unsat_pos[d]] = last;
+          unsat_pos[last] = unsat_pos[d];
+          unsat.pop_back();
+        }
+      }
+      for (const uint32_t d : occurs[(~lit).lidx()]) {
+        if (--true_count[d] == 0) {
+          unsat_pos[d] = unsat.size();
+          unsat.push_back(d);
+        }
+      }
+      if (unsat.size() < best_unsat) {
+        best_unsat = unsat.size();
+        best = value;
+      }
+    }
+    phases = best;
+  }
+  void init_restarts() {
+    switch (restart_kind()) {
+    case RestartKind::Luby:
+      focused_restart = std::make_unique<LubyRestart>(100);
+      break;
+    case RestartKind::Geometric:
+      focused_restart = std::make_unique<GeometricRestart>(100, 1.5);
+      break;
+    case RestartKind::Glucose:
+      focused_restart = std::make_unique<GlucoseRestart>();
+      break;
+    }
+    // reluctant doubling
+    stable_restart = std::make_unique<LubyRestart>(1024);
+    stable = options.mode == SearchMode::Stable;
+  }
+  // Call f with the current restart policy. It has its concrete type if it
+  // is known at compile time, so the calls are not virtual.
+  template <class F> decltype(auto) with_restart_policy(F f) {
+    if (stable) {
+      return f(static_cast<LubyRestart &>(*stable_restart));
+    }
+    if constexpr (Traits::restart == RestartKind::Luby) {
+      return f(static_cast<LubyRestart &>(*focused_restart));
+    } else if constexpr (Traits::restart == RestartKind::Geometric) {
+      return f(static_cast<GeometricRestart &>(*focused_restart));
+    } else if constexpr (Traits::restart == RestartKind::Glucose) {
+      return f(static_cast<GlucoseRestart &>(*focused_restart));
+    } else {
+      return f(*focused_restart);
+    }
+  }
+  // Alternate focused and stable mode in the doubling intervals.
+  void switch_mode() {
+    stable = !stable;
+    mode_switch_interval *= 2;
+    next_mode_switch = conflicts + mode_switch_interval;
+    with_restart_policy([](auto &policy) { policy.on_restart(); });
+  }
+  // An unassigned variable if any
+  std::optional<Var> next_decision_var() {
+    if (use_vmtf()) {
+      return vmtf.next_unassigned([&](Var v) {
+        return eval(Lit(v, true)) != LitBool::Undefine ||
+               eliminated[static_cast<size_t>(v)];
+      });
+    }
+    if (decision_kind() == DecisionKind::Lrb) {
+      lrb_decay_top();
+    }
+    return order_heap.pop();
+  }
+  // Stop solve() as soon as possible. This is safe to call from another thread
+  // or a signal handler and lasts until clear_interrupt().
+  void interrupt() { interrupted.store(true, std::memory_order_relaxed); }
+  void clear_interrupt() {
+    interrupted.store(false, std::memory_order_relaxed);
+  }
+  [[nodiscard]] uint64_t num_conflicts() const { return conflicts; }
+  // all zero unless the traits enable stats
+  [[nodiscard]] const Statistics &stats() const { return statistics; }
+  [[nodiscard]] uint64_t num_propagations() const { return propagations; }
+  [[nodiscard]] uint64_t num_ticks() const { return ticks; }
+  // the irredundant and learnt clauses with more than two literals
+  [[nodiscard]] size_t num_clauses() const { return clauses.size(); }
+  [[nodiscard]] size_t num_learnts() const { return learnts.size(); }
+  // Set the limits of this solve() call from the budget.
+  void start_budget() {
+    conflict_limit = budget.conflicts ? conflicts + budget.conflicts.value()
+                                      : std::numeric_limits<uint64_t>::max();
+    propagation_limit = budget.propagations
+                            ? propagations + budget.propagations.value()
+                            : std::numeric_limits<uint64_t>::max();
+    tick_limit = budget.ticks ? ticks + budget.ticks.value()
+                              : std::numeric_limits<uint64_t>::max();
+    deadline = std::nullopt;
+    if (budget.seconds) {
+      const std::chrono::duration<double> limit(budget.seconds.value());
+      deadline = std::chrono::steady_clock::now() +
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(limit);
+    }
+    budget_checks = 0;
+  }
+  [[nodiscard]] bool within_budget() {
+    if (interrupted.load(std::memory_order_relaxed) ||
+        conflicts >= conflict_limit || propagations >= propagation_limit ||
+        ticks >= tick_limit) {
+      return false;
+    }
+    // read the clock once in a while
+    if (deadline && (budget_checks++ & (CLOCK_CHECK_INTERVAL - 1)) == 0) {
+      return std::chrono::steady_clock::now() < deadline.value();
+    }
+    return true;
+  }
+  // The formula is unsatisfiable.
+  Status refute() {
+    inconsistent = true;
+    proof_add(nullptr, nullptr);
+    status = Status::Unsat;
+    return Status::Unsat;
+  }
+  // The assumptions that imply the negation of a false assumption p.
+  // failed_assumptions gets p and the assumptions on the trail from which it
+  // is implied.
+  void analyze_final(Lit p) {
+    failed_assumptions.clear();
+    failed_assumptions.push_back(p);
+    if (vardata[p.vidx()].level == 0) {
+      return;
+    }
+    seen[p.vidx()] = true;
+    // only assumptions are decided below the assumption levels
+    seen_decisions(failed_assumptions);
+  }
+  // Append the decisions from which the seen literals are implied and clear
+  // seen.
+  void seen_decisions(std::vector<Lit> &decisions) {
+    for (size_t i = trail.size(); i-- > trail_lim[0];) {
+      const Lit lit = trail[i];
+      if (!seen[lit.vidx()]) {
+        continue;
+      }
+      seen[lit.vidx()] = false;
+      const std::optional<Reason> &reason = vardata[lit.vidx()].reason;
+      if (!reason) {
+        decisions.push_back(lit);
+        continue;
+      }
+      Lit other;
+      const auto [begin, end] = reason_lits(reason.value(), other);
+      for (const Lit *it = begin; it != end; it++) {
+        if (vardata[it->vidx()].level > 0) {
+          seen[it->vidx()] = true;
+        }
+      }
+    }
+  }
+  // Log DRAT steps to `to` (nullptr to stop). It takes effect only if
+  // Traits::proof, which Solver has with BULLSAT_PROOF. The proof is for
+  // this solver alone, so clauses must not be shared with other solvers and
+  // clauses added by add_clause() belong to the formula.
+  void set_proof(ProofWriter *to) { proof = to; }
+  // Sat or Unsat, or Unknown if the budget runs out or it is interrupted.
+  // The assumptions are decided first in order. If the formula is Unsat
+  // under them, failed_assumptions is the subset of them that is Unsat (empty
+  // if the formula itself is Unsat).
+  // Learnt clauses and heuristics are kept between calls, the next call
+  // resumes search and clauses can be added in between. It throws
+  // std::invalid_argument if an assumption was eliminated or the traits
+  // disable assumptions.
+  Status solve(const std::vector<Lit> &assumptions = {}) {
+    if (!Traits::assumptions && !assumptions.empty()) {
+      throw std::invalid_argument("assumptions are disabled by the traits");
+    }
+    failed_assumptions.clear();
+    if (inconsistent) {
+      return refute();
+    }
+    for (const Lit lit : assumptions) {
+      grow_vars(lit.vidx() + 1);
+      check_not_eliminated(lit);
+    }
+    for (const Lit lit : assumptions) {
+      frozen[lit.vidx()] = true;
+    }
+    if (options.preprocess && !preprocessed) {
+      preprocessed = true;
+      preprocess();
+      if (inconsistent) {
+        return refute();
+      }
+    }
+    if (!focused_restart) {
+      init_restarts();
+      rng = Random(options.seed);
+    }
+    start_budget();
+    while (true) {
+      if (!within_budget()) {
+        pop_queue_until(0);
+        status = Status::Unknown;
+        return Status::Unknown;
+      }
+      if (std::optional<Conflict> conflict = propagate()) {
+        // Conflict
+        conflicts++;
+        if (decision_level() == 0) {
+          return refute();
+        }
+        auto [learnt_clause, back_jump_level] = analyze(conflict.value());
+        proof_add(learnt_clause.data(),
+                  learnt_clause.data() + learnt_clause.size());
+        if constexpr (Traits::stats) {
+          statistics.learnt_units += learnt_clause.size() == 1;
+          statistics.learnt_binaries += learnt_clause.size() == 2;
+          statistics.learnt_literals += learnt_clause.size();
+        }
+        const uint32_t lbd =
+            compute_lbd(learnt_clause.data(),
+                        learnt_clause.data() + learnt_clause.size());
+        // the conflict is found at the last level
+        update_target_and_best(trail_lim.back());
+        pop_queue_until(back_jump_level);
+        if (learnt_clause.size() == 1) {
+          enqueue(learnt_clause[0]);
+          // a unit clause can simplify clauses
+          // (!x1)
+          // Delete: (!x1 v x2 v x3)
+          skip_simplify = false;
+        } else if (learnt_clause.size() == 2) {
+          add_binary(learnt_clause[0], learnt_clause[1]);
+          enqueue(learnt_clause[0], Reason::binary(learnt_clause[1]));
+        } else {
+          CRef cr = arena.alloc(learnt_clause, true);
+          arena[cr].set_lbd(lbd);
+          attach_clause(cr);
+          clause_bump_activity(arena[cr]);
+          enqueue(learnt_clause[0], Reason::clause(cr));
+        }
+        if (exchange) {
+          export_learnt(learnt_clause, lbd);
+        }
+
+        if (decision_kind() == DecisionKind::Lrb) {
+          lrb_step = std::max(LRB_MIN_STEP, lrb_step - LRB_STEP_DECAY);
+        } else if (use_vmtf()) {
+          vmtf_bump_vars();
+        } else {
+          var_bump_inc *= (1.0 / options.var_decay);
+        }
+        clause_bump_inc *= (1.0 / 0.999);
+        with_restart_policy([&](auto &policy) { policy.on_conflict(lbd); });
+      } else {
+        // No Conflict
+        if (options.mode == SearchMode::Switch &&
+            conflicts >= next_mode_switch) {
+          switch_mode();
+          restarts++;
+          update_target_and_best(trail.size());
+          pop_queue_until(0);
+        } else if (with_restart_policy([](auto &policy) {
+                     return policy.should_restart();
+                   })) {
+          with_restart_policy([](auto &policy) { policy.on_restart(); });
+          restarts++;
+          update_target_and_best(trail.size());
+          pop_queue_until(0);
+        }
+        if (options.rephase && conflicts >= next_rephase) {
+          update_target_and_best(trail.size());
+          pop_queue_until(0);
+          rephase();
+        }
+        if (exchange && decision_level() == 0) {
+          if (on_share) {
+            on_share();
+          }
+          import_shared();
+          if (inconsistent) {
+            return refute();
+          }
+        }
+        // at the next restart
+        if ((options.inprocess || options.vivify) &&
+            conflicts >= next_inprocess &&
+            decision_level() == 0) {
+          inprocess();
+          if (inconsistent) {
+            return refute();
+          }
+        }
+
+        if (!skip_simplify && decision_level() == 0) {
+          // simplify clauses at the top level.
+          simplify();
+          skip_simplify = true;
+        }
+
+        if (conflicts >= next_reduce) {
+          // Reduce the set of learnt clauses
+          reduce_interval += REDUCE_INCREMENT;
+          next_reduce = conflicts + reduce_interval;
+          reduce_learnts();
+        }
+        bool assumed = false;
+        if constexpr (Traits::assumptions) {
+          while (!assumed && static_cast<size_t>(decision_level()) <
+                                 assumptions.size()) {
+            const Lit p = assumptions[static_cast<size_t>(decision_level())];
+            const LitBool value = eval(p);
+            if (value == LitBool::True) {
+              // an empty level keeps levels and assumptions aligned
+              trail_lim.push_back(trail.size());
+            } else if (value == LitBool::False) {
+              analyze_final(p);
+              pop_queue_until(0);
+              status = Status::Unsat;
+              return Status::Unsat;
+            } else {
+              new_decision(p);
+              assumed = true;
+            }
+          }
+        }
+        while (!assumed) {
+          // std::cout << std::endl;
+          if (std::optional<Var> v = next_decision_var()) {
+            if (eval(Lit(v.value(), true)) != LitBool::Undefine ||
+                eliminated[static_cast<size_t>(v.value())]) {
+              continue;
+            }
+
+            Lit next = Lit(v.value(), decide_phase(v.value()));
+            new_decision(next);
+            if constexpr (Traits::stats) {
+              statistics.decisions++;
+            }
+            break;
+          } else {
+            model.resize(num_vars());
+            for (size_t i = 0; i < num_vars(); i++) {
+              model[i] = eval(Lit(Var(i), true)) == LitBool::True;
+            }
+            extend_model();
+            pop_queue_until(0);
+            status = Status::Sat;
+            return Status::Sat;
+          }
+        }
+      }
     }
   }
-  [[nodiscard]] LitBool eval(Lit lit) const {
-    if (!levels[lit.vidx()].has_value()) {
-      return LitBool::Undefine;
+  // All variables
+public:
+  // a satisfying assignment of all variables
+  std::vector<bool> model;
+  // the assumptions responsible for the last Unsat
+  std::vector<Lit> failed_assumptions;
+  // the result of the last solve()
+  std::optional<Status> status;
+  Options options;
+  Budget budget;
+
+private:
+  // compact the arena when this fraction of it is wasted
+  static constexpr double GARBAGE_FRACTION = 0.2;
+  // learnt clause tiers
+  static constexpr uint32_t CORE_LBD = 2;
+  static constexpr uint32_t TIER2_LBD = 6;
+  // reduce learnt clauses every REDUCE_FIRST + k * REDUCE_INCREMENT conflicts
+  static constexpr uint64_t REDUCE_FIRST = 2000;
+  static constexpr uint64_t REDUCE_INCREMENT = 300;
+  // the first length of focused/stable mode in conflicts
+  static constexpr uint64_t MODE_SWITCH_FIRST = 1000;
+  // the k-th rephase happens REPHASE_INTERVAL * k conflicts after the last
+  static constexpr uint64_t REPHASE_INTERVAL = 1000;
+  // LRB step size from 0.4 to 0.06 by 1e-6 per conflict
+  static constexpr double LRB_STEP = 0.4;
+  static constexpr double LRB_MIN_STEP = 0.06;
+  static constexpr double LRB_STEP_DECAY = 1e-6;
+  // the score of an unassigned variable decays per conflict
+  static constexpr double LRB_DECAY = 0.95;
+  // read the clock every CLOCK_CHECK_INTERVAL budget checks (a power of 2)
+  static constexpr uint64_t CLOCK_CHECK_INTERVAL = 256;
+  // the effort of preprocessing in literals visited
+  static constexpr uint64_t PREPROCESS_STEPS = 100000000;
+  // the k-th inprocessing happens INPROCESS_INTERVAL * k conflicts after the
+  // last
+  static constexpr uint64_t INPROCESS_INTERVAL = 2000;
+  // probing takes 1/PROBE_RATIO of the search ticks
+  static constexpr uint64_t PROBE_RATIO = 10;
+  static constexpr uint64_t PROBE_MIN_TICKS = 100000;
+  // vivification takes 1/VIVIFY_RATIO of the search ticks
+  static constexpr uint64_t VIVIFY_RATIO = 10;
+  static constexpr uint64_t VIVIFY_MIN_TICKS = 100000;
+  // lookahead tries at most this number of variables
+  static constexpr size_t LOOKAHEAD_CANDIDATES = 100;
+  // clause sharing exports about SHARE_TARGET clauses per
+  // SHARE_ADJUST_INTERVAL conflicts
+  static constexpr uint64_t SHARE_ADJUST_INTERVAL = 1000;
+  static constexpr uint64_t SHARE_TARGET = 100;
+  // local search
+  static constexpr double WALK_CB = 2.38;
+  static constexpr size_t WALK_MAX_BREAK = 64;
+  static constexpr uint64_t WALK_FLIPS = 20;
+  static constexpr uint64_t WALK_MAX_FLIPS = 1000000;
+  ClauseArena arena;
+  std::vector<CRef> clauses, learnts;
+  std::vector<std::vector<Watcher>> watchers;
+  // literal -> implied literals by binary clauses
+  std::vector<std::vector<Lit>> implications;
+  // literal index -> the value of the literal
+  std::vector<LitBool> values;
+  std::vector<VarData> vardata;
+  // the last assigned value of each variable
+  std::vector<bool> phases;
+  // 1: positive, -1: negative, 0: none
+  std::vector<int8_t> target_phases, best_phases;
+  std::vector<bool> seen;
+  // work space of analyze()
+  std::vector<Lit> analyze_stack, analyze_toclear;
+  bool skip_simplify;
+
+  // assigned literals in order
+  std::vector<Lit> trail;
+  // trail_lim[i] is the start of the decision level i + 1 in the trail
+  std::vector<size_t> trail_lim;
+  size_t que_head;
+  size_t binary_head;
+  Heap order_heap;
+  double var_bump_inc;
+  Vmtf vmtf;
+  // variables to move to the front after conflict analysis
+  std::vector<Var> vmtf_bumped;
+  struct LrbData {
+    // the number of conflicts when it was assigned/unassigned
+    uint64_t assigned_at;
+    uint64_t canceled;
+    // the number of learnt clauses it took part in/was a reason of while
+    // assigned
+    uint32_t participated;
+    uint32_t reasoned;
+  };
+  std::vector<LrbData> lrb;
+  // the step size of the moving average
+  double lrb_step;
+  double clause_bump_inc;
+  // level -> the last stamp of compute_lbd()
+  std::vector<uint64_t> level_stamps;
+  uint64_t lbd_stamp;
+  uint64_t conflicts;
+  uint64_t reduce_interval;
+  uint64_t next_reduce;
+  std::unique_ptr<RestartPolicy> focused_restart, stable_restart;
+  // in stable mode
+  bool stable;
+  uint64_t restarts;
+  uint64_t mode_switch_interval;
+  uint64_t next_mode_switch;
+  size_t target_assigned;
+  size_t best_assigned;
+  uint64_t rephases;
+  uint64_t next_rephase;
+  Random rng;
+  // statistics
+  uint64_t propagations;
+  uint64_t ticks;
+  // limits of the current solve() call
+  uint64_t conflict_limit;
+  uint64_t propagation_limit;
+  uint64_t tick_limit;
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  uint64_t budget_checks;
+  std::atomic<bool> interrupted;
+  // The formula is unsatisfiable without assumptions.
+  bool inconsistent;
+  bool preprocessed;
+  // variables that are not eliminated
+  std::vector<bool> frozen;
+  std::vector<bool> eliminated;
+  // the clauses removed by elimination and substitution, the eliminated
+  // literal first
+  std::vector<Lit> elim_lits;
+  std::vector<size_t> elim_offsets;
+  uint64_t inprocessings;
+  uint64_t next_inprocess;
+  // ticks at the end of the last inprocessing
+  uint64_t inprocess_ticks;
+  // clause sharing
+  ClauseExchange *exchange;
+  size_t share_id;
+  // the next clause to read from each ring
+  std::vector<uint64_t> share_cursors;
+  // hashes of the clauses exported or imported
+  std::unordered_set<uint64_t> shared_hashes;
+  Clause share_buffer;
+  // the LBD limit of exported clauses
+  uint32_t share_lbd;
+  uint64_t share_recent;
+  uint64_t next_share_adjust;
+  uint64_t exported;
+  uint64_t imported;
+  ProofWriter *proof;
+  // the top-level literals already logged as units
+  size_t proof_head;
+  Statistics statistics;
+};
+using Solver = BasicSolver<>;
+
+// Portfolio
+// The options of the i-th solver of a portfolio. The first solver keeps the
+// base options and the others vary the seed, the restart policy, the search
+// mode, the decision heuristic, the phases and the activity decay.
+inline Options diversify(const Options &base, size_t i) {
+  Options options = base;
+  if (i == 0) {
+    return options;
+  }
+  static constexpr RestartKind RESTARTS[] = {
+      RestartKind::Luby, RestartKind::Glucose, RestartKind::Geometric};
+  static constexpr SearchMode MODES[] = {SearchMode::Switch, SearchMode::Stable,
+                                         SearchMode::Focused};
+  static constexpr DecisionKind DECISIONS[] = {
+      DecisionKind::Vmtf, DecisionKind::Evsids, DecisionKind::Lrb,
+      DecisionKind::Auto};
+  static constexpr double VAR_DECAYS[] = {0.95, 0.9, 0.8, 0.99, 0.85};
+  options.seed = base.seed + i;
+  options.restart = RESTARTS[i % 3];
+  options.mode = MODES[(i / 3) % 3];
+  options.decision = DECISIONS[i % 4];
+  options.initial_phase = (i % 2 == 1) != base.initial_phase;
+  options.target_phase = (i / 2) % 2 == 0;
+  options.var_decay = VAR_DECAYS[i % 5];
+  return options;
+}
+
+// Solvers with diversified options race on the same formula in threads.
+// The formula is shared read-only and the first definitive answer stops the
+// others. Short learnt clauses are shared through a ClauseExchange.
+class Portfolio {
+public:
+  // The solvers share learnt clauses if `share` is true.
+  Portfolio(size_t threads, const Options &options, bool share = true)
+      : base(options), sharing(share), solved(false) {
+    make_solvers(std::max<size_t>(threads, 1));
+  }
+  // Load the formula into every solver and solve it under the budget. Each
+  // call solves with new solvers, so the formulas of the calls are
+  // independent.
+  Status solve(const CnfData &cnf, const Budget &budget = Budget()) {
+    if (solved) {
+      // the solvers hold the last formula, maybe with eliminated variables
+      make_solvers(solvers.size());
     }
-    if (lit.neg()) {
-      return assings[lit.vidx()] ? LitBool::False : LitBool::True;
+    solved = true;
+    status = std::nullopt;
+    winner = std::nullopt;
+    model.clear();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < solvers.size(); i++) {
+      threads.emplace_back([&, i]() {
+        Solver &solver = *solvers[i];
+        solver.budget = budget;
+        solver.load(cnf);
+        const Status result = solver.solve();
+        if (result == Status::Unknown) {
+          return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (winner) {
+          return;
+        }
+        winner = i;
+        status = result;
+        model = solver.model;
+        for (size_t j = 0; j < solvers.size(); j++) {
+          if (j != i) {
+            solvers[j]->interrupt();
+          }
+        }
+      });
     }
-    return assings[lit.vidx()] ? LitBool::True : LitBool::False;
-  }
-  [[nodiscard]] int decision_level() const {
-    if (que.empty()) {
-      return 0;
+    for (std::thread &thread : threads) {
+      thread.join();
     }
-
-    Lit l = que.back();
-    return levels[l.vidx()].value_or(0);
+    if (!status) {
+      status = Status::Unknown;
+    }
+    return status.value();
   }
-  void new_decision(Lit lit, std::optional<CRef> reason = std::nullopt) {
-    enqueue(lit, reason);
-    levels[lit.vidx()].value()++;
+  // Stop every solver. This is safe to call from another thread or a signal
+  // handler.
+  void interrupt() {
+    for (const std::unique_ptr<Solver> &solver : solvers) {
+      solver->interrupt();
+    }
   }
+  [[nodiscard]] size_t size() const { return solvers.size(); }
+  [[nodiscard]] const Solver &solver(size_t i) const { return *solvers[i]; }
+
+  // a satisfying assignment found by the winner
+  std::vector<bool> model;
+  // the result of the last solve()
+  std::optional<Status> status;
+  // the solver that answered first
+  std::optional<size_t> winner;
 
-  void enqueue(Lit lit, std::optional<CRef> reason = std::nullopt) {
-    assert(!levels[lit.vidx()].has_value());
-    levels[lit.vidx()] = decision_level();
-    assings[lit.vidx()] = lit.pos() ? true : false;
-    reasons[lit.vidx()] = reason;
-    que.push_back(lit);
+private:
+  void make_solvers(size_t n) {
+    solvers.clear();
+    exchange = std::make_unique<ClauseExchange>(n);
+    for (size_t i = 0; i < n; i++) {
+      solvers.push_back(std::make_unique<Solver>());
+      solvers.back()->options = diversify(base, i);
+      if (sharing) {
+        solvers.back()->share(exchange.get(), i);
+      }
+    }
   }
 
-  void pop_queue_until(int until_level) {
-    assert(!que.empty());
+  Options base;
+  bool sharing;
+  // solve() was called and the solvers are used
+  bool solved;
+  std::unique_ptr<ClauseExchange> exchange;
+  std::vector<std::unique_ptr<Solver>> solvers;
+  std::mutex mutex;
+};
 
-    while (!que.empty()) {
-      Lit lit = que.back();
-      if (levels[lit.vidx()] > until_level) {
-        if (!order_heap.in_heap(lit.var())) {
-          order_heap.push(lit.var());
-        }
-        reasons[lit.vidx()] = std::nullopt;
-        levels[lit.vidx()] = std::nullopt;
-        que.pop_back();
-      } else {
-        break;
-      }
+// Cube and conquer
+// The formula is split into cubes by lookahead and the cubes are solved as
+// assumptions by solvers in threads. Each thread takes cubes from the back of
+// its own deque and steals from the front of the others. A cube that is not
+// solved within cube_conflicts conflicts is split again into the deque.
+// Variables are not eliminated because a cube can have any variable.
+class CubeAndConquer {
+public:
+  CubeAndConquer(size_t threads, const Options &options)
+      : base(options), solved(false), queues(std::max<size_t>(threads, 1)),
+        pending(0), queued(0), stop(false), total_conflicts(0), cubes(0),
+        refuted(0) {
+    make_solvers();
+  }
+  // Split the formula into cubes of `depth` literals and solve them under
+  // the budget. Each call solves with new solvers.
+  Status solve(const CnfData &cnf, size_t depth,
+               const Budget &budget = Budget()) {
+    if (solved) {
+      // the solvers hold the last formula and learnt clauses
+      make_solvers();
     }
-    if (que.size() > 0) {
-      que_head = que.size() - 1;
+    solved = true;
+    for (WorkQueue &queue : queues) {
+      queue.cubes.clear();
+    }
+    status = std::nullopt;
+    model.clear();
+    stop = false;
+    total_conflicts = 0;
+    cubes = 0;
+    refuted = 0;
+    if (budget.seconds) {
+      const std::chrono::duration<double> limit(budget.seconds.value());
+      deadline = std::chrono::steady_clock::now() +
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(limit);
     } else {
-      que_head = 0;
+      deadline = std::nullopt;
+    }
+    conflict_limit = budget.conflicts;
+
+    Solver &first = *solvers[0];
+    first.load(cnf);
+    const std::vector<Clause> initial = first.cubes({}, depth);
+    if (initial.empty()) {
+      return finish(Status::Unsat);
+    }
+    pending = initial.size();
+    queued = initial.size();
+    cubes = initial.size();
+    for (size_t i = 0; i < initial.size(); i++) {
+      queues[i % queues.size()].cubes.push_back(initial[i]);
     }
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < solvers.size(); i++) {
+      threads.emplace_back([&, i]() { work(i, cnf); });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    if (!status) {
+      status = pending == 0 ? Status::Unsat : Status::Unknown;
+    }
+    return status.value();
   }
-  void var_bump_activity(Var v, double inc) {
-    const size_t idx = static_cast<size_t>(v);
-    order_heap.activity[idx] += inc;
-    if (order_heap.activity[idx] > 1e100) {
-      // rescale
-      for (size_t i = 0; i < assings.size(); i++) {
-        order_heap.activity[i] *= 1e-100;
-      }
-      var_bump_inc *= 1e-100;
+  // Stop every solver. This is safe to call from another thread or a signal
+  // handler.
+  void interrupt() {
+    stop = true;
+    for (const std::unique_ptr<Solver> &solver : solvers) {
+      solver->interrupt();
     }
-    if (order_heap.in_heap(v)) {
-      order_heap.update(v);
+  }
+  [[nodiscard]] size_t size() const { return solvers.size(); }
+  [[nodiscard]] const Solver &solver(size_t i) const { return *solvers[i]; }
+  // the cubes made and refuted in the last solve()
+  [[nodiscard]] uint64_t num_cubes() const { return cubes; }
+  [[nodiscard]] uint64_t num_refuted() const { return refuted; }
+
+  // a satisfying assignment
+  std::vector<bool> model;
+  // the result of the last solve()
+  std::optional<Status> status;
+  // conflicts before a cube is split again
+  uint64_t cube_conflicts = 1000;
+
+private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Clause> cubes;
+  };
+  void make_solvers() {
+    solvers.clear();
+    for (size_t i = 0; i < queues.size(); i++) {
+      solvers.push_back(std::make_unique<Solver>());
+      Options &worker = solvers.back()->options;
+      worker = base;
+      worker.seed = base.seed + i;
+      worker.preprocess = false;
+      worker.inprocess = false;
     }
   }
-  void new_var() {
-    // literal index
-    Var v = Var(assings.size());
-    watchers.push_back(std::vector<CWRef>());
-    watchers.push_back(std::vector<CWRef>());
-    // variable index
-    assings.push_back(false);
-    seen.push_back(false);
-    reasons.push_back(std::nullopt);
-    levels.push_back(std::nullopt);
-    order_heap.push(v);
-  }
-  void unwatch_clause(const CRef &cr) {
-    const Clause &clause = *cr;
-    assert(clause.size() > 1);
-    for (const auto idx : {0, 1}) {
-      std::vector<CWRef> &watcher =
-          watchers[(~clause[static_cast<size_t>(idx)]).lidx()];
-
-      for (size_t i = 0; i < watcher.size(); i++) {
-        assert(!watcher[i].expired());
-        if (watcher[i].lock() == cr) {
-          watcher[i] = watcher.back();
-          watcher.pop_back();
-          break;
-        }
+  Status finish(Status result) {
+    std::lock_guard<std::mutex> lock(result_mutex);
+    if (!status) {
+      status = result;
+    }
+    interrupt();
+    return status.value();
+  }
+  // The back of its own deque or the front of another one.
+  std::optional<Clause> take(size_t id) {
+    for (size_t k = 0; k < queues.size(); k++) {
+      WorkQueue &queue = queues[(id + k) % queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.cubes.empty()) {
+        continue;
+      }
+      Clause cube;
+      if (k == 0) {
+        cube = std::move(queue.cubes.back());
+        queue.cubes.pop_back();
+      } else {
+        cube = std::move(queue.cubes.front());
+        queue.cubes.pop_front();
       }
+      queued--;
+      return cube;
     }
-    return;
+    return std::nullopt;
   }
-  void watch_clause(const CRef &cr) {
-    const Clause &clause = *cr;
-    assert(clause.size() > 1);
-    watchers[(~clause[0]).lidx()].push_back(cr);
-    watchers[(~clause[1]).lidx()].push_back(cr);
+  // Wake the idle threads after a change of queued, pending or stop.
+  void wake() {
+    { std::lock_guard<std::mutex> lock(idle_mutex); }
+    idle.notify_all();
   }
-  void attach_clause(const CRef &cr, bool learnt = false) {
-
-    assert((*cr).size() > 1);
-    watch_clause(cr);
-    if (learnt) {
-      learnts.push_back(cr);
-    } else {
-      clauses.push_back(cr);
+  // Wait for a cube to steal or the end of the search. interrupt() from a
+  // signal handler can't notify, so stop is checked now and then too.
+  void wait_idle() {
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    idle.wait_for(lock, std::chrono::milliseconds(IDLE_MILLISECONDS),
+                  [&]() { return stop || pending == 0 || queued > 0; });
+  }
+  // Solve a cube within the conflicts and the time left.
+  Status solve_cube(Solver &solver, const Clause &cube,
+                    std::optional<uint64_t> conflicts) {
+    solver.budget = Budget();
+    solver.budget.conflicts = conflicts;
+    if (deadline) {
+      const std::chrono::duration<double> left =
+          deadline.value() - std::chrono::steady_clock::now();
+      solver.budget.seconds = std::max(0.0, left.count());
     }
+    const uint64_t before = solver.num_conflicts();
+    const Status result = solver.solve(cube);
+    total_conflicts += solver.num_conflicts() - before;
+    if (conflict_limit && total_conflicts >= conflict_limit.value()) {
+      interrupt();
+    }
+    return result;
   }
-
-  void add_clause(const Clause &clause) {
-    assert(decision_level() == 0);
-    // grow the size
-    std::for_each(clause.begin(), clause.end(), [&](Lit lit) {
-      if (lit.vidx() >= assings.size()) {
-        new_var();
+  void work(size_t id, const CnfData &cnf) {
+    conquer(id, cnf);
+    // the others may wait for this thread
+    wake();
+  }
+  void conquer(size_t id, const CnfData &cnf) {
+    Solver &solver = *solvers[id];
+    if (id != 0) {
+      solver.load(cnf);
+    }
+    while (!stop && pending > 0) {
+      std::optional<Clause> cube = take(id);
+      if (!cube) {
+        wait_idle();
+        continue;
       }
-    });
-    Clause ps = clause;
-    size_t new_len = 0;
-    std::sort(ps.begin(), ps.end());
-    for (size_t i = 0; i < ps.size(); i++) {
-      if (eval(ps[i]) == LitBool::True) {
+      if (deadline && std::chrono::steady_clock::now() >= deadline.value()) {
+        interrupt();
         return;
       }
-      if (i >= 1) {
-        if (ps[i] == ~ps[i - 1]) {
-          return;
-        }
-        if (ps[i] == ps[i - 1]) {
+      Status result = solve_cube(solver, cube.value(), cube_conflicts);
+      if (result == Status::Unknown && !stop) {
+        // too hard
+        std::vector<Clause> halves = solver.cubes(cube.value(), 1);
+        if (halves.size() != 1 || halves[0] != cube.value()) {
+          cubes += halves.size();
+          refuted += halves.empty() ? 1 : 2 - halves.size();
+          // counted before another thread can take and refute a half
+          pending += halves.size();
+          pending--;
+          {
+            std::lock_guard<std::mutex> lock(queues[id].mutex);
+            for (Clause &half : halves) {
+              queues[id].cubes.push_back(std::move(half));
+            }
+            queued += halves.size();
+          }
+          wake();
           continue;
         }
+        // nothing to split on
+        result = solve_cube(solver, cube.value(), std::nullopt);
       }
-      if (eval(ps[i]) != LitBool::False) {
-        ps[new_len++] = ps[i];
+      if (result == Status::Sat) {
+        std::lock_guard<std::mutex> lock(result_mutex);
+        if (!status) {
+          status = Status::Sat;
+          model = solver.model;
+        }
+        interrupt();
+        return;
+      }
+      if (result == Status::Unknown) {
+        // interrupted or out of the budget
+        interrupt();
+        return;
+      }
+      refuted++;
+      if (solver.failed_assumptions.empty()) {
+        // unsatisfiable without assumptions
+        finish(Status::Unsat);
+        return;
+      }
+      if (--pending == 0) {
+        wake();
       }
-    }
-    ps.resize(new_len);
-    if (ps.empty()) {
-      status = Status::Unsat;
-    } else if (ps.size() == 1) {
-      // Unit Clause
-      enqueue(ps[0]);
-    } else {
-      CRef cr = std::make_shared<Clause>(ps);
-      attach_clause(cr);
     }
   }
-  [[nodiscard]] std::optional<CRef> propagate() {
-    while (que_head < que.size()) {
-      assert(que_head >= 0);
-      const Lit lit = que[que_head++];
-      const Lit nlit = ~lit;
-
-      std::vector<CWRef> &watcher = watchers[lit.lidx()];
-      for (size_t i = 0; i < watcher.size();) {
-        assert(!watcher[i].expired());
-        CRef cr = watcher[i].lock();
-        const size_t next_idx = i + 1;
-        Clause &clause = *cr;
-
-        assert(clause[0] == nlit || clause[1] == nlit);
-        // make sure that the clause[1] it false.
-        if (clause[0] == nlit) {
-          std::swap(clause[0], clause[1]);
-        }
-        assert(clause[1] == nlit && eval(clause[1]) == LitBool::False);
 
-        Lit first = clause[0];
-        // Already satisfied
-        if (eval(first) == LitBool::True) {
-          i = next_idx;
-          goto nextclause;
-        }
-        // clause[0] is False or Undefine
-        // clause[1] is False
-        // clause[2..] is False or True or Undefine.
+  Options base;
+  // solve() was called and the solvers are used
+  bool solved;
+  std::vector<std::unique_ptr<Solver>> solvers;
+  std::vector<WorkQueue> queues;
+  static constexpr int IDLE_MILLISECONDS = 10;
+  // the cubes in the deques or being solved
+  std::atomic<uint64_t> pending;
+  // the cubes in the deques
+  std::atomic<uint64_t> queued;
+  std::atomic<bool> stop;
+  // idle threads wait for cubes to steal
+  std::mutex idle_mutex;
+  std::condition_variable idle;
+  std::mutex result_mutex;
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  std::optional<uint64_t> conflict_limit;
+  std::atomic<uint64_t> total_conflicts;
+  std::atomic<uint64_t> cubes;
+  std::atomic<uint64_t> refuted;
+};
 
-        for (size_t k = 2; k < clause.size(); k++) {
-          // Found a new lit to watch
-          if (eval(clause[k]) != LitBool::False) {
-            std::swap(clause[1], clause[k]);
-            // Remove a value(swap the last one and pop back)
-            watcher[i] = watcher.back();
-            watcher.pop_back();
-            // New watch
-            watchers[(~clause[1]).lidx()].push_back(cr);
-            goto nextclause;
-          }
-        }
+// Multi-process solving
+// Messages between a coordinator and its workers on a stream socket: the
+// type, the number of words and the words. Literals are sent as Lit::x.
+enum class MessageType : int32_t {
+  Job = 1,
+  Shared = 2,
+  Sat = 3,
+  Unsat = 4,
+  Unknown = 5
+};
+struct Message {
+  MessageType type;
+  std::vector<int32_t> words;
+};
+inline void append_message(std::vector<char> &out, MessageType type,
+                           const int32_t *words, size_t size) {
+  const int32_t header[2] = {static_cast<int32_t>(type),
+                             static_cast<int32_t>(size)};
+  const char *begin = reinterpret_cast<const char *>(header);
+  out.insert(out.end(), begin, begin + sizeof(header));
+  begin = reinterpret_cast<const char *>(words);
+  out.insert(out.end(), begin, begin + size * sizeof(int32_t));
+}
+// Write all the bytes to a blocking socket.
+inline bool send_all(int fd, const std::vector<char> &bytes) {
+  size_t sent = 0;
+  while (sent < bytes.size()) {
+    const ssize_t n =
+        ::send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
 
-        // clause[2..] is False
-        if (eval(first) == LitBool::False) {
-          // All literals are false
-          // Conflict
-          return std::move(cr);
-        } else {
-          // All literals excepting first are false
-          // Unit Propagation
-          assert(eval(first) == LitBool::Undefine);
-          enqueue(first, cr);
-          i = next_idx;
-        }
-      nextclause:;
+// Cut the bytes of a socket into messages.
+class MessageReader {
+public:
+  // Read what is available without blocking. Return false at the end of the
+  // stream or on an error.
+  bool fill(int fd) {
+    char buffer[1 << 16];
+    while (true) {
+      const ssize_t n = ::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (n > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + n);
+        continue;
       }
+      if (n == 0) {
+        return false;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
     }
-
-    return std::nullopt;
+  }
+  std::optional<Message> next() {
+    const size_t available = bytes.size() - head;
+    int32_t header[2];
+    if (available < sizeof(header)) {
+      return std::nullopt;
+    }
+    std::memcpy(header, bytes.data() + head, sizeof(header));
+    const size_t words = static_cast<size_t>(std::max(header[1], 0));
+    if (available < sizeof(header) + words * sizeof(int32_t)) {
+      return std::nullopt;
+    }
+    Message message{static_cast<MessageType>(header[0]),
+                    std::vector<int32_t>(words)};
+    if (words > 0) {
+      std::memcpy(message.words.data(), bytes.data() + head + sizeof(header),
+                  words * sizeof(int32_t));
+    }
+    head += sizeof(header) + words * sizeof(int32_t);
+    if (head == bytes.size()) {
+      bytes.clear();
+      head = 0;
+    }
+    return message;
   }
 
-  [[nodiscard]] std::pair<Clause, int> analyze(CRef conflict) {
-    Clause learnt_clause;
-    assert([&]() {
-      bool ok = false;
-      for (const bool b : seen) {
-        ok |= b;
-      }
-      return !ok;
-    }());
-    const int conflicted_decision_level = decision_level();
+private:
+  std::vector<char> bytes;
+  size_t head = 0;
+};
 
-    int counter = 0;
-    {
-      const Clause &clause = *conflict;
+// A coordinator forks worker processes and talks to each over a Unix domain
+// socket. Every worker solves the formula with diversified options, or the
+// cubes of it one at a time. Learnt units and binaries streamed back by a
+// worker are forwarded to the others, and a worker that dies is restarted
+// with its job, so a crash or a memory blowup loses only that job.
+class Coordinator {
+public:
+  Coordinator(size_t process_num, const Options &base)
+      : processes(std::max<size_t>(process_num, 1)), options(base),
+        stop(false), restarts(0), cubes(0), refuted(0) {}
+  // Solve the formula under the budget. Without `cube_depth` the workers
+  // race on the whole formula. Otherwise the formula is split into cubes of
+  // the depth which are handed to idle workers.
+  Status solve(const CnfData &cnf,
+               std::optional<size_t> cube_depth = std::nullopt,
+               const Budget &budget = Budget()) {
+    status = std::nullopt;
+    model.clear();
+    stop = false;
+    restarts = 0;
+    cubes = 0;
+    refuted = 0;
+    shared.clear();
+    cube_mode = cube_depth.has_value();
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    if (budget.seconds) {
+      const std::chrono::duration<double> limit(budget.seconds.value());
+      deadline = std::chrono::steady_clock::now() +
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(limit);
+    }
+    worker_conflicts = budget.conflicts;
 
-      // variables that are used to traverse by a conflicted clause
-      for (const Lit &lit : clause) {
-        assert(eval(lit) == LitBool::False);
-        seen[lit.vidx()] = true;
-        var_bump_activity(lit.var(), var_bump_inc);
-        if (levels[lit.vidx()] < conflicted_decision_level) {
-          learnt_clause.emplace_back(lit);
-        } else {
-          counter += 1;
+    std::deque<Clause> jobs;
+    if (cube_mode) {
+      Solver splitter;
+      splitter.options = options;
+      splitter.options.preprocess = false;
+      splitter.load(cnf);
+      for (Clause &cube : splitter.cubes({}, cube_depth.value())) {
+        jobs.push_back(std::move(cube));
+      }
+      cubes = jobs.size();
+      if (jobs.empty()) {
+        status = Status::Unsat;
+        return status.value();
+      }
+    } else {
+      jobs.assign(processes, Clause());
+    }
+    // jobs given up after a crash or out of the budget
+    bool lost = false;
+    workers.assign(processes, Worker());
+    for (size_t id = 0; id < workers.size() && !jobs.empty(); id++) {
+      spawn(id, cnf, std::move(jobs.front()), 0);
+      jobs.pop_front();
+    }
+    std::vector<pollfd> fds;
+    std::vector<size_t> ids;
+    while (!status && !stop) {
+      if (deadline && std::chrono::steady_clock::now() >= deadline.value()) {
+        break;
+      }
+      fds.clear();
+      ids.clear();
+      for (size_t id = 0; id < workers.size(); id++) {
+        if (workers[id].fd < 0) {
+          continue;
+        }
+        const short events = static_cast<short>(
+            POLLIN | (workers[id].outbox.empty() ? 0 : POLLOUT));
+        fds.push_back(pollfd{workers[id].fd, events, 0});
+        ids.push_back(id);
+      }
+      if (fds.empty()) {
+        break;
+      }
+      if (::poll(fds.data(), fds.size(), POLL_MILLISECONDS) <= 0) {
+        // timeout or a signal
+        continue;
+      }
+      for (size_t k = 0; k < fds.size() && !status; k++) {
+        const size_t id = ids[k];
+        Worker &worker = workers[id];
+        if (fds[k].revents == 0) {
+          continue;
+        }
+        if ((fds[k].revents & POLLOUT) != 0) {
+          flush(worker);
         }
+        const bool alive = worker.reader.fill(worker.fd);
+        std::optional<Message> message;
+        while (!status && (message = worker.reader.next())) {
+          if (message->type == MessageType::Shared) {
+            forward(id, message->words);
+            continue;
+          }
+          if (message->type == MessageType::Sat) {
+            model.resize(message->words.size());
+            for (size_t v = 0; v < model.size(); v++) {
+              model[v] = message->words[v] != 0;
+            }
+            status = Status::Sat;
+            break;
+          }
+          if (message->type == MessageType::Unsat) {
+            refuted++;
+            if (message->words.empty() || message->words[0] == 0) {
+              // unsatisfiable without assumptions
+              status = Status::Unsat;
+              break;
+            }
+          } else if (message->type == MessageType::Unknown) {
+            lost = true;
+          }
+          worker.job = std::nullopt;
+          if (!jobs.empty()) {
+            assign(worker, std::move(jobs.front()));
+            jobs.pop_front();
+          }
+        }
+        if (alive || status || stop) {
+          continue;
+        }
+        // the worker died
+        ::close(worker.fd);
+        worker.fd = -1;
+        ::waitpid(worker.pid, nullptr, 0);
+        if (!worker.job) {
+          continue;
+        }
+        if (worker.attempts > MAX_RESTARTS) {
+          lost = true;
+          continue;
+        }
+        restarts++;
+        spawn(id, cnf, std::move(worker.job.value()), worker.attempts);
+      }
+      if (!status && jobs.empty() &&
+          std::none_of(workers.begin(), workers.end(),
+                       [](const Worker &worker) {
+                         return worker.job.has_value();
+                       })) {
+        status = cube_mode && !lost ? Status::Unsat : Status::Unknown;
       }
-      assert(counter >= 1);
     }
+    for (Worker &worker : workers) {
+      if (worker.fd < 0) {
+        continue;
+      }
+      ::kill(worker.pid, SIGKILL);
+      ::close(worker.fd);
+      ::waitpid(worker.pid, nullptr, 0);
+      worker.fd = -1;
+    }
+    if (!status) {
+      status = Status::Unknown;
+    }
+    return status.value();
+  }
+  // Stop solving. This is safe to call from a signal handler.
+  void interrupt() { stop = true; }
+  [[nodiscard]] size_t size() const { return processes; }
+  // the workers restarted after a crash in the last solve()
+  [[nodiscard]] uint64_t num_restarts() const { return restarts; }
+  // the cubes made and refuted in the last solve()
+  [[nodiscard]] uint64_t num_cubes() const { return cubes; }
+  [[nodiscard]] uint64_t num_refuted() const { return refuted; }
 
-    // traverse a implication graph to a 1-UIP(first-uinque-implication-point)
-    std::optional<Lit> first_uip = std::nullopt;
-    for (size_t i = que.size() - 1; true; i--) {
-      Lit lit = que[i];
-      // Skip a variable that isn't checked.
-      if (!seen[lit.vidx()]) {
+  // a satisfying assignment
+  std::vector<bool> model;
+  // the result of the last solve()
+  std::optional<Status> status;
+  // Called in a new worker process with its id and how many times it has
+  // been started for the job before solving. Tests use it to crash workers.
+  std::function<void(size_t, size_t)> on_worker_start;
+
+private:
+  // restarts of a job before it is given up
+  static constexpr size_t MAX_RESTARTS = 3;
+  // bytes waiting for a worker before shared clauses are dropped
+  static constexpr size_t MAX_OUTBOX = 1 << 20;
+  static constexpr int POLL_MILLISECONDS = 100;
+  struct Worker {
+    pid_t pid = -1;
+    int fd = -1;
+    // starts for the current job
+    size_t attempts = 0;
+    std::optional<Clause> job;
+    MessageReader reader;
+    std::vector<char> outbox;
+  };
+  [[nodiscard]] Options worker_options(size_t id) const {
+    if (!cube_mode) {
+      return diversify(options, id);
+    }
+    Options worker = options;
+    worker.seed = options.seed + id;
+    worker.preprocess = false;
+    worker.inprocess = false;
+    return worker;
+  }
+  // Write what the socket takes without blocking.
+  static void flush(Worker &worker) {
+    while (!worker.outbox.empty()) {
+      const ssize_t n = ::send(worker.fd, worker.outbox.data(),
+                               worker.outbox.size(),
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) {
         continue;
       }
-      counter--;
-      if (counter <= 0) {
-        // 1-UIP
-        first_uip = lit;
+      if (n <= 0) {
+        return;
+      }
+      worker.outbox.erase(worker.outbox.begin(), worker.outbox.begin() + n);
+    }
+  }
+  void assign(Worker &worker, Clause cube) {
+    std::vector<int32_t> words;
+    for (const Lit lit : cube) {
+      words.push_back(lit.x);
+    }
+    append_message(worker.outbox, MessageType::Job, words.data(),
+                   words.size());
+    worker.job = std::move(cube);
+    flush(worker);
+  }
+  // Send a new clause of worker `from` to the others.
+  void forward(size_t from, std::vector<int32_t> &clause) {
+    std::sort(clause.begin(), clause.end());
+    if (!shared.insert(clause).second) {
+      return;
+    }
+    for (size_t id = 0; id < workers.size(); id++) {
+      Worker &worker = workers[id];
+      if (id == from || worker.fd < 0 || worker.outbox.size() > MAX_OUTBOX) {
+        continue;
+      }
+      append_message(worker.outbox, MessageType::Shared, clause.data(),
+                     clause.size());
+    }
+  }
+  // Start worker `id` for the job and send it the clauses shared so far.
+  // `attempt` is the number of earlier starts for the job.
+  void spawn(size_t id, const CnfData &cnf, Clause job, size_t attempt) {
+    Worker &worker = workers[id];
+    int ends[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, ends) != 0) {
+      throw std::runtime_error(std::string("socketpair: ") +
+                               std::strerror(errno));
+    }
+    const pid_t pid = ::fork();
+    if (pid < 0) {
+      throw std::runtime_error(std::string("fork: ") + std::strerror(errno));
+    }
+    if (pid == 0) {
+      ::close(ends[0]);
+      for (const Worker &other : workers) {
+        if (other.fd >= 0) {
+          ::close(other.fd);
+        }
+      }
+      try {
+        run_worker(id, attempt, ends[1], cnf);
+      } catch (...) {
+        ::_exit(1);
+      }
+    }
+    ::close(ends[1]);
+    worker = Worker();
+    worker.pid = pid;
+    worker.fd = ends[0];
+    worker.attempts = attempt + 1;
+    for (const std::vector<int32_t> &clause : shared) {
+      if (worker.outbox.size() > MAX_OUTBOX) {
         break;
       }
-      seen[lit.vidx()] = false;
-
-      assert(reasons[lit.vidx()].has_value());
-      assert(!reasons[lit.vidx()].value().expired());
-      CRef reason = reasons[lit.vidx()].value().lock();
-      const Clause clause = *reason;
-      assert(clause[0] == lit);
-      for (size_t j = 1; j < clause.size(); j++) {
-        Lit clit = clause[j];
-        // Already checked
-        if (seen[clit.vidx()]) {
+      append_message(worker.outbox, MessageType::Shared, clause.data(),
+                     clause.size());
+    }
+    assign(worker, std::move(job));
+  }
+  // The worker process: solve the jobs, sending the learnt units and
+  // binaries and receiving the shared ones at the restarts of the solver.
+  // The received clauses go into a ClauseExchange ring that the solver
+  // imports from.
+  [[noreturn]] void run_worker(size_t id, size_t attempt, int fd,
+                               const CnfData &cnf) {
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    if (on_worker_start) {
+      on_worker_start(id, attempt);
+    }
+    Solver solver;
+    solver.options = worker_options(id);
+    solver.load(cnf);
+    ClauseExchange exchange(2);
+    solver.share(&exchange, 0);
+    uint64_t cursor = 0;
+    Clause clause;
+    MessageReader reader;
+    std::vector<char> out;
+    std::vector<int32_t> words;
+    const auto receive = [&](const Message &message) {
+      clause.clear();
+      for (const int32_t x : message.words) {
+        Lit lit;
+        lit.x = x;
+        clause.push_back(lit);
+      }
+      if (message.type == MessageType::Shared && !clause.empty() &&
+          clause.size() <= SharedRing::MAX_SIZE) {
+        exchange.ring(1).push(clause.data(), clause.size(), 1);
+        return false;
+      }
+      return message.type == MessageType::Job;
+    };
+    while (true) {
+      // wait for a job
+      std::optional<Message> message;
+      while (!(message = reader.next()) || !receive(message.value())) {
+        if (message) {
           continue;
         }
-        seen[clit.vidx()] = true;
-        var_bump_activity(lit.var(), var_bump_inc);
-        if (levels[clit.vidx()] < conflicted_decision_level) {
-          learnt_clause.push_back(clit);
-        } else {
-          counter += 1;
+        pollfd wait{fd, POLLIN, 0};
+        ::poll(&wait, 1, -1);
+        if (!reader.fill(fd)) {
+          ::_exit(0);
+        }
+      }
+      const Clause cube = clause;
+      // Forward the learnt units and binaries and take those of the others
+      // at the restarts of the solver, so its restart policy and search
+      // mode are kept.
+      solver.on_share = [&]() {
+        out.clear();
+        exchange.ring(0).read(cursor, clause, [&](Clause &learnt, uint32_t) {
+          if (learnt.size() > 2) {
+            return;
+          }
+          words.clear();
+          for (const Lit lit : learnt) {
+            words.push_back(lit.x);
+          }
+          append_message(out, MessageType::Shared, words.data(),
+                         words.size());
+        });
+        if (!send_all(fd, out) || !reader.fill(fd)) {
+          ::_exit(0);
+        }
+        while (std::optional<Message> incoming = reader.next()) {
+          receive(incoming.value());
         }
+      };
+      solver.budget = Budget();
+      solver.budget.conflicts = worker_conflicts;
+      const Status result = solver.solve(cube);
+      out.clear();
+      words.clear();
+      if (result == Status::Sat) {
+        for (const bool value : solver.model) {
+          words.push_back(value ? 1 : 0);
+        }
+      } else if (result == Status::Unsat) {
+        words.push_back(solver.failed_assumptions.empty() ? 0 : 1);
+      }
+      const MessageType type = result == Status::Sat     ? MessageType::Sat
+                               : result == Status::Unsat ? MessageType::Unsat
+                                                         : MessageType::Unknown;
+      append_message(out, type, words.data(), words.size());
+      if (!send_all(fd, out)) {
+        ::_exit(0);
       }
     }
-    assert(first_uip.has_value());
-    // learnt_clause[0] = !first_uip
-    learnt_clause.push_back(~(first_uip.value()));
-    std::swap(learnt_clause[0], learnt_clause.back());
+  }
 
-    // Back Jump
-    int back_jump_level = 0;
-    for (size_t i = 1; i < learnt_clause.size(); i++) {
-      assert(levels[learnt_clause[i].vidx()].has_value());
-      back_jump_level =
-          std::max(back_jump_level, levels[learnt_clause[i].vidx()].value());
+  size_t processes;
+  Options options;
+  bool cube_mode = false;
+  std::vector<Worker> workers;
+  // the units and binaries sent to the workers
+  std::set<std::vector<int32_t>> shared;
+  std::optional<uint64_t> worker_conflicts;
+  std::atomic<bool> stop;
+  uint64_t restarts;
+  uint64_t cubes;
+  uint64_t refuted;
+};
+
+// DIMACS CNF
+class ParseError : public std::runtime_error {
+public:
+  ParseError(size_t at, const std::string &message)
+      : std::runtime_error("line " + std::to_string(at) + ": " + message),
+        line(at) {}
+  size_t line;
+};
+
+// A source of bytes for the DIMACS parser.
+class InputSource {
+public:
+  InputSource() = default;
+  InputSource(const InputSource &) = delete;
+  InputSource &operator=(const InputSource &) = delete;
+  virtual ~InputSource() = default;
+  using Block = std::pair<const char *, size_t>;
+  // Return the next block of the input. An empty block is the end.
+  virtual Block next_block() = 0;
+};
+
+// Read a std::istream in large chunks.
+class StreamSource : public InputSource {
+public:
+  explicit StreamSource(std::istream &stream)
+      : in(stream), buffer(BLOCK_SIZE) {}
+  Block next_block() override {
+    in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return {buffer.data(), static_cast<size_t>(in.gcount())};
+  }
+
+private:
+  static constexpr size_t BLOCK_SIZE = 1 << 20;
+  std::istream &in;
+  std::vector<char> buffer;
+};
+
+// Read a file descriptor in large chunks. It is used for pipes and stdin.
+class FdSource : public InputSource {
+public:
+  explicit FdSource(int file) : fd(file), buffer(BLOCK_SIZE) {}
+  Block next_block() override {
+    while (true) {
+      const ssize_t n = ::read(fd, buffer.data(), buffer.size());
+      if (n >= 0) {
+        return {buffer.data(), static_cast<size_t>(n)};
+      }
+      if (errno != EINTR) {
+        throw std::runtime_error(std::string("read: ") + std::strerror(errno));
+      }
     }
+  }
 
-    for (const Lit &lit : learnt_clause) {
-      seen[lit.vidx()] = false;
+private:
+  static constexpr size_t BLOCK_SIZE = 1 << 20;
+  int fd;
+  std::vector<char> buffer;
+};
+
+// Map a whole regular file into memory.
+class MmapSource : public InputSource {
+public:
+  MmapSource(int fd, size_t length) : size(length), done(false) {
+    addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error(std::string("mmap: ") + std::strerror(errno));
+    }
+    ::madvise(addr, size, MADV_SEQUENTIAL);
+  }
+  ~MmapSource() override { ::munmap(addr, size); }
+  Block next_block() override {
+    if (done) {
+      return {nullptr, 0};
     }
+    done = true;
+    return {static_cast<const char *>(addr), size};
+  }
 
-    return std::make_pair(learnt_clause, back_jump_level);
+private:
+  void *addr;
+  size_t size;
+  bool done;
+};
+
+// Base of sources that decompress the bytes of another source.
+class DecompressSource : public InputSource {
+protected:
+  DecompressSource(InputSource &compressed, Block first)
+      : in(compressed), pending(first), out(BLOCK_SIZE), finished(false) {}
+  // Return the pending compressed bytes. An empty block is the end.
+  Block input() {
+    if (pending.second == 0) {
+      pending = in.next_block();
+    }
+    return pending;
   }
-  bool locked(const CRef &cr) {
-    const Clause &clause = *cr;
+  void consume(size_t n) {
+    pending.first += n;
+    pending.second -= n;
+  }
+
+  static constexpr size_t BLOCK_SIZE = 1 << 20;
+  InputSource &in;
+  Block pending;
+  std::vector<char> out;
+  bool finished;
+};
 
-    if (eval(clause[0]) == LitBool::True &&
-        reasons[clause[0].vidx()].has_value()) {
-      // A clause is being propagated.
-      assert(!reasons[clause[0].vidx()].value().expired());
-      return reasons[clause[0].vidx()].value().lock() == cr;
+#ifdef BULLSAT_ZLIB
+class GzipSource : public DecompressSource {
+public:
+  GzipSource(InputSource &compressed, Block first)
+      : DecompressSource(compressed, first), stream(), in_member(false) {
+    // 15 + 16: gzip format with the maximum window
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+      throw std::runtime_error("gzip: failed to initialize");
     }
-    return false;
   }
-  void reduce_learnts() {
-    std::sort(learnts.begin(), learnts.end(),
-              [](const auto &left, const auto &right) {
-                return left->size() < right->size();
-              });
-    size_t new_size = learnts.size() / 2;
-    std::unordered_set<CRef> crs;
-    for (size_t i = new_size; i < learnts.size(); i++) {
-      if (learnts[i]->size() > 2 && !locked(learnts[i])) {
-        unwatch_clause(learnts[i]);
-        crs.insert(learnts[i]);
+  ~GzipSource() override { inflateEnd(&stream); }
+  Block next_block() override {
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    while (!finished && stream.avail_out > 0) {
+      const Block block = input();
+      if (block.second == 0) {
+        if (in_member) {
+          throw std::runtime_error("gzip: unexpected end of input");
+        }
+        finished = true;
+        break;
+      }
+      const size_t avail =
+          std::min<size_t>(block.second, std::numeric_limits<uInt>::max());
+      stream.next_in = reinterpret_cast<const Bytef *>(block.first);
+      stream.avail_in = static_cast<uInt>(avail);
+      const int ret = inflate(&stream, Z_NO_FLUSH);
+      consume(avail - stream.avail_in);
+      if (ret == Z_STREAM_END) {
+        // a gzip file may have several members
+        inflateReset(&stream);
+        in_member = false;
+      } else if (ret == Z_OK) {
+        in_member = true;
       } else {
-        learnts[new_size] = learnts[i];
-        new_size++;
+        throw std::runtime_error(std::string("gzip: ") +
+                                 (stream.msg ? stream.msg : "corrupt input"));
       }
     }
-    learnts.resize(new_size);
+    return {out.data(), out.size() - stream.avail_out};
   }
 
-  void simplify() {
-    assert(decision_level() == 0);
-    auto remove_satisfied = [&](std::vector<CRef> &cls) {
-      // learnts
-      size_t new_cls_size = 0;
-      for (size_t i = 0; i < cls.size(); i++) {
-        CRef cr = cls[i];
-        const Clause &clause = *cr;
-        bool satisfied = false;
-        for (size_t j = 0; j < clause.size(); j++) {
-          LitBool lb = eval(clause[j]);
-          if (lb == LitBool::True) {
-            unwatch_clause(cr);
-            satisfied = true;
-            break;
-          }
-        }
-
-        if (!satisfied) {
-          cls[new_cls_size] = cr;
-          new_cls_size++;
-        }
-      }
-      cls.resize(new_cls_size);
-    };
+private:
+  z_stream stream;
+  bool in_member;
+};
+#endif
 
-    remove_satisfied(learnts);
-    remove_satisfied(clauses);
+#ifdef BULLSAT_LZMA
+class XzSource : public DecompressSource {
+public:
+  XzSource(InputSource &compressed, Block first)
+      : DecompressSource(compressed, first), stream(LZMA_STREAM_INIT) {
+    if (lzma_stream_decoder(&stream, std::numeric_limits<uint64_t>::max(),
+                            LZMA_CONCATENATED) != LZMA_OK) {
+      throw std::runtime_error("xz: failed to initialize");
+    }
   }
-  Status solve() {
-    if (status) {
-      return status.value();
+  ~XzSource() override { lzma_end(&stream); }
+  Block next_block() override {
+    stream.next_out = reinterpret_cast<uint8_t *>(out.data());
+    stream.avail_out = out.size();
+    while (!finished && stream.avail_out > 0) {
+      const Block block = input();
+      stream.next_in = reinterpret_cast<const uint8_t *>(block.first);
+      stream.avail_in = block.second;
+      const lzma_ret ret =
+          lzma_code(&stream, block.second == 0 ? LZMA_FINISH : LZMA_RUN);
+      consume(block.second - stream.avail_in);
+      if (ret == LZMA_STREAM_END) {
+        finished = true;
+      } else if (ret != LZMA_OK) {
+        throw std::runtime_error("xz: corrupt or truncated input");
+      }
     }
-    double max_limit_learnts = static_cast<double>(clauses.size()) * 0.3;
-    size_t conflict_cnt = 0;
-    double restart_limit = 100;
-    while (true) {
-      if (std::optional<CRef> conflict = propagate()) {
-        // Conflict
-        conflict_cnt++;
-        if (decision_level() == 0) {
-          status = Status::Unsat;
-          return Status::Unsat;
-        }
-        auto [learnt_clause, back_jump_level] = analyze(conflict.value());
-        pop_queue_until(back_jump_level);
-        if (learnt_clause.size() == 1) {
-          enqueue(learnt_clause[0]);
-          // a unit clause can simplify clauses
-          // (!x1)
-          // Delete: (!x1 v x2 v x3)
-          skip_simplify = false;
-        } else {
-          CRef cr = std::make_shared<Clause>(learnt_clause);
-          attach_clause(cr, true);
-          enqueue(learnt_clause[0], cr);
-        }
-
-        var_bump_inc *= (1.0 / 0.95);
-      } else {
-        // No Conflict
-        if (conflict_cnt >= static_cast<size_t>(restart_limit)) {
-          restart_limit *= 1.1;
-          pop_queue_until(0);
-        }
+    return {out.data(), out.size() - stream.avail_out};
+  }
 
-        if (!skip_simplify && decision_level() == 0) {
-          // simplify clauses at the top level.
-          simplify();
-          skip_simplify = true;
-        }
+private:
+  lzma_stream stream;
+};
+#endif
 
-        if (learnts.size() >= static_cast<size_t>(max_limit_learnts)) {
-          // Reduce the set of learnt clauses
-          max_limit_learnts *= 1.1;
-          reduce_learnts();
+#ifdef BULLSAT_BZIP2
+class Bzip2Source : public DecompressSource {
+public:
+  Bzip2Source(InputSource &compressed, Block first)
+      : DecompressSource(compressed, first), stream(), in_stream(false) {
+    if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK) {
+      throw std::runtime_error("bzip2: failed to initialize");
+    }
+  }
+  ~Bzip2Source() override { BZ2_bzDecompressEnd(&stream); }
+  Block next_block() override {
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<unsigned int>(out.size());
+    while (!finished && stream.avail_out > 0) {
+      const Block block = input();
+      if (block.second == 0) {
+        if (in_stream) {
+          throw std::runtime_error("bzip2: unexpected end of input");
         }
-        while (true) {
-          // std::cout << std::endl;
-          if (std::optional<Var> v = order_heap.pop()) {
-            const size_t idx = static_cast<size_t>(v.value());
-            if (levels[idx].has_value()) {
-              continue;
-            }
-
-            Lit next = Lit(v.value(), assings[idx]);
-            new_decision(next);
-            break;
-          } else {
-            status = Status::Sat;
-            return Status::Sat;
-          }
+        finished = true;
+        break;
+      }
+      const size_t avail = std::min<size_t>(
+          block.second, std::numeric_limits<unsigned int>::max());
+      // libbz2 doesn't write to the input
+      stream.next_in = const_cast<char *>(block.first);
+      stream.avail_in = static_cast<unsigned int>(avail);
+      const int ret = BZ2_bzDecompress(&stream);
+      consume(avail - stream.avail_in);
+      if (ret == BZ_STREAM_END) {
+        // concatenated streams (e.g. pbzip2)
+        char *next_out = stream.next_out;
+        const unsigned int avail_out = stream.avail_out;
+        BZ2_bzDecompressEnd(&stream);
+        stream = bz_stream();
+        if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK) {
+          throw std::runtime_error("bzip2: failed to initialize");
         }
+        stream.next_out = next_out;
+        stream.avail_out = avail_out;
+        in_stream = false;
+      } else if (ret == BZ_OK) {
+        in_stream = true;
+      } else {
+        throw std::runtime_error("bzip2: corrupt input");
       }
     }
-    status = Status::Unknown;
-    return Status::Unknown;
+    return {out.data(), out.size() - stream.avail_out};
   }
-  // All variables
-public:
-  std::vector<bool> assings;
-  std::optional<Status> status;
 
 private:
-  std::vector<CRef> clauses, learnts;
-  std::vector<std::vector<CWRef>> watchers;
-  std::vector<std::optional<CWRef>> reasons;
-  std::vector<std::optional<int>> levels;
-  std::vector<bool> seen;
-  bool skip_simplify;
-
-  std::deque<Lit> que;
-  size_t que_head;
-  Heap order_heap;
-  double var_bump_inc;
+  bz_stream stream;
+  bool in_stream;
 };
-struct CnfData {
-  std::optional<size_t> var_num;
-  std::optional<size_t> clause_num;
-  std::vector<Clause> clauses;
-};
-CnfData parse_cnf(std::istream &in) {
-  std::string line;
-  const std::regex pattern("p cnf (\\d+) (\\d+)");
-  CnfData data = {};
-  while (std::getline(in, line)) {
-    std::stringstream stream(line);
-    std::string word;
+#endif
 
-    std::vector<std::string> words;
+enum class Compression { None, Gzip, Xz, Bzip2 };
 
-    while (std::getline(stream, word, ' ')) {
-      if (word.empty()) {
-        continue;
+// Detect a compressed input by its magic number.
+Compression detect_compression(InputSource::Block first) {
+  auto starts_with = [&](const char *magic, size_t size) {
+    return first.second >= size && std::memcmp(first.first, magic, size) == 0;
+  };
+  if (starts_with("\x1f\x8b", 2)) {
+    return Compression::Gzip;
+  }
+  if (starts_with("\xfd" "7zXZ\x00", 6)) {
+    return Compression::Xz;
+  }
+  if (starts_with("BZh", 3)) {
+    return Compression::Bzip2;
+  }
+  return Compression::None;
+}
+
+// Scan DIMACS CNF by hand into a flat literal buffer.
+class DimacsParser {
+public:
+  // `first` is a block already read from `source`.
+  explicit DimacsParser(InputSource &input,
+                        InputSource::Block first = {nullptr, 0})
+      : source(input), cur(first.first), end(first.first + first.second),
+        line(1) {}
+
+  CnfData parse() {
+    CnfData data = {};
+    while (true) {
+      skip_spaces();
+      const int c = peek();
+      if (c == EOF || c == '%') {
+        // SATLIB instances end with "%"
+        break;
+      }
+      if (c == 'c') {
+        skip_line();
+      } else if (c == 'p') {
+        parse_header(data);
+      } else {
+        parse_lit(data);
       }
-      words.push_back(word);
     }
-    if (words.empty() || words[0] == "c") {
-      continue;
+    if (data.offsets.back() != data.lits.size()) {
+      // the last clause isn't terminated by 0
+      data.offsets.push_back(data.lits.size());
     }
+    return data;
+  }
 
-    line = std::accumulate(
-        std::next(words.begin()), words.end(), words[0],
-        [](std::string left, std::string right) { return left + " " + right; });
-    std::smatch matches;
-
-    // p cnf 123 567
-    if (std::regex_match(line, matches, pattern)) {
-      int var_num = std::stoi(matches[1]);
-      int clause_num = std::stoi(matches[2]);
-      if (var_num >= 0 && clause_num >= 0) {
-        data.var_num = var_num;
-        data.clause_num = clause_num;
+private:
+  int peek() {
+    if (cur == end) {
+      auto [block, size] = source.next_block();
+      if (size == 0) {
+        return EOF;
       }
-      continue;
+      cur = block;
+      end = block + size;
+    }
+    return static_cast<unsigned char>(*cur);
+  }
+  void advance() {
+    if (*cur == '\n') {
+      line++;
     }
-    // Parse a clause from line.
-    // 1 2 -3 0
-    Clause clause = Clause();
-    for (const auto &w : words) {
-      if (w == "0") {
+    cur++;
+  }
+  static bool is_space(int c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+  static bool is_digit(int c) { return '0' <= c && c <= '9'; }
+  void skip_spaces() {
+    while (is_space(peek())) {
+      advance();
+    }
+  }
+  // Skip spaces and tabs but not a newline.
+  void skip_blanks() {
+    for (int c = peek(); c == ' ' || c == '\t' || c == '\r'; c = peek()) {
+      advance();
+    }
+  }
+  void skip_line() {
+    for (int c = peek(); c != EOF; c = peek()) {
+      advance();
+      if (c == '\n') {
         break;
       }
-      int num = std::stoi(w);
-      assert(num != 0);
-      int d = std::abs(num) - 1;
-      if (num > 0) {
-        clause.emplace_back(Lit(d, true));
-      } else {
-        clause.emplace_back(Lit(d, false));
+    }
+  }
+  [[noreturn]] void error(const std::string &message) const {
+    throw ParseError(line, message);
+  }
+  std::string describe(int c) const {
+    if (c == EOF) {
+      return "end of file";
+    }
+    return "'" + std::string(1, static_cast<char>(c)) + "'";
+  }
+  // Read a non-negative integer.
+  uint64_t read_uint() {
+    int c = peek();
+    if (!is_digit(c)) {
+      error("expected a number but found " + describe(c));
+    }
+    uint64_t value = 0;
+    for (; is_digit(c); c = peek()) {
+      value = value * 10 + static_cast<uint64_t>(c - '0');
+      if (value > MAX_VALUE) {
+        error("number is too large");
+      }
+      advance();
+    }
+    if (c != EOF && !is_space(c)) {
+      error("unexpected " + describe(c) + " after a number");
+    }
+    return value;
+  }
+  // p cnf 123 567
+  void parse_header(CnfData &data) {
+    if (data.var_num.has_value()) {
+      error("duplicated header");
+    }
+    advance();
+    skip_blanks();
+    for (const char expected : {'c', 'n', 'f'}) {
+      if (peek() != expected) {
+        error("expected 'p cnf <variables> <clauses>'");
+      }
+      advance();
+    }
+    skip_blanks();
+    const uint64_t var_num = read_uint();
+    skip_blanks();
+    const uint64_t clause_num = read_uint();
+    skip_blanks();
+    if (peek() != '\n' && peek() != EOF) {
+      error("unexpected " + describe(peek()) + " after the header");
+    }
+    data.var_num = static_cast<size_t>(var_num);
+    data.clause_num = static_cast<size_t>(clause_num);
+    data.offsets.reserve(data.clause_num.value() + 1);
+  }
+  // Parse a literal. 0 terminates the current clause.
+  void parse_lit(CnfData &data) {
+    bool negative = false;
+    if (peek() == '-') {
+      negative = true;
+      advance();
+    }
+    const uint64_t num = read_uint();
+    if (num == 0) {
+      if (negative) {
+        error("unexpected '-0'");
       }
+      data.offsets.push_back(data.lits.size());
+      return;
     }
-    if (!clause.empty()) {
-      data.clauses.emplace_back(clause);
+    data.lits.emplace_back(Var(num - 1), !negative);
+  }
+
+  // variables are stored as 2 * v + 1 in an int
+  static constexpr uint64_t MAX_VALUE = std::numeric_limits<int>::max() / 2;
+  InputSource &source;
+  const char *cur, *end;
+  size_t line;
+};
+
+// Parse a plain or compressed input.
+CnfData parse_source(InputSource &source) {
+  const InputSource::Block first = source.next_block();
+  switch (detect_compression(first)) {
+  case Compression::Gzip: {
+#ifdef BULLSAT_ZLIB
+    GzipSource gzip(source, first);
+    return DimacsParser(gzip).parse();
+#else
+    throw std::runtime_error("gzip input needs a build with ZLIB=1");
+#endif
+  }
+  case Compression::Xz: {
+#ifdef BULLSAT_LZMA
+    XzSource xz(source, first);
+    return DimacsParser(xz).parse();
+#else
+    throw std::runtime_error("xz input needs a build with LZMA=1");
+#endif
+  }
+  case Compression::Bzip2: {
+#ifdef BULLSAT_BZIP2
+    Bzip2Source bzip2(source, first);
+    return DimacsParser(bzip2).parse();
+#else
+    throw std::runtime_error("bzip2 input needs a build with BZIP2=1");
+#endif
+  }
+  case Compression::None:
+    break;
+  }
+  return DimacsParser(source, first).parse();
+}
+
+CnfData parse_cnf(std::istream &in) {
+  StreamSource source(in);
+  return parse_source(source);
+}
+
+// Parse a DIMACS CNF file. "-" is the standard input.
+// A regular file is mapped into memory and other files are read in chunks.
+// gzip, xz and bzip2 files are decompressed while parsing.
+CnfData parse_cnf_file(const std::string &path) {
+  const int fd = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(std::strerror(errno));
+  }
+  struct FdCloser {
+    ~FdCloser() {
+      if (fd != STDIN_FILENO) {
+        ::close(fd);
+      }
     }
+    int fd;
+  } closer{fd};
+
+  struct stat st = {};
+  if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    MmapSource source(fd, static_cast<size_t>(st.st_size));
+    return parse_source(source);
   }
-  return data;
+  FdSource source(fd);
+  return parse_source(source);
 }
 } // namespace bullsat
 
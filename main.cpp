@@ -1,16 +1,313 @@
 #include "bullsat.hpp"
+#include <cerrno>
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 using namespace bullsat;
 void help() {
-  std::cout << "Usage: bullsat <input-file> [output-file]" << std::endl;
+  std::cout << "Usage: bullsat [options] <input-file|-> [output-file]\n"
+            << "Options:\n"
+            << "  --restart=<luby|geometric|glucose>  restart policy in focused "
+               "mode (default: glucose)\n"
+            << "  --mode=<focused|stable|switch>      search mode (default: "
+               "switch)\n"
+            << "  --decide=<evsids|vmtf|auto|lrb>     decision heuristic, auto "
+               "uses vmtf in focused mode (default: evsids)\n"
+            << "  --rephase=<on|off>                  reset phases periodically "
+               "(default: on)\n"
+            << "  --preprocess=<on|off>               eliminate variables and "
+               "subsumed clauses (default: on)\n"
+            << "  --inprocess=<on|off>                probe and substitute "
+               "equivalent literals (default: on)\n"
+            << "  --vivify=<on|off>                   shorten clauses by "
+               "vivification (default: on)\n"
+            << "  --seed=<n>                          random seed (default: "
+               "0)\n"
+            << "  --threads=<n>                       race n solvers with "
+               "different options (default: 1)\n"
+            << "  --cubes=<depth>                     split into cubes of the "
+               "depth and solve them in the threads\n"
+            << "  --processes=<n>                     solve in n worker "
+               "processes, with --cubes one cube at a time\n"
+            << "  --proof=<file>                      write a DRAT proof of "
+               "UNSAT\n"
+            << "  --proof-format=<drat|binary>        text or binary DRAT "
+               "(default: drat)\n"
+            << "  --stats=<on|off>                    print search statistics "
+               "(default: off)\n"
+            << "  --conflicts=<n>                     give up after n "
+               "conflicts\n"
+            << "  --time=<seconds>                    give up after the time"
+            << std::endl;
 }
 
-void write_result(const Solver &solver, Status status, std::ostream &os,
-                  bool tostdout) {
+std::optional<uint64_t> parse_uint(const std::string &value) {
+  char *end = nullptr;
+  errno = 0;
+  const unsigned long long n = std::strtoull(value.c_str(), &end, 10);
+  if (value.empty() || value[0] == '-' || *end != '\0' || errno != 0) {
+    return std::nullopt;
+  }
+  return n;
+}
+
+// How to use threads and processes
+struct Parallel {
+  size_t threads = 1;
+  // a coordinator with worker processes if it is more than one
+  size_t processes = 1;
+  // cube and conquer if it is set
+  std::optional<size_t> cube_depth;
+};
+
+// Where to write a proof
+struct ProofOutput {
+  std::optional<std::string> path;
+  ProofFormat format = ProofFormat::Drat;
+};
+
+// Parse an option "--name=value" into options, budget, parallel, proof and
+// stats.
+bool parse_option(const std::string &arg, Options &options, Budget &budget,
+                  Parallel &parallel, ProofOutput &proof, bool &stats) {
+  const size_t eq = arg.find('=');
+  if (eq == std::string::npos) {
+    return false;
+  }
+  const std::string name = arg.substr(0, eq);
+  const std::string value = arg.substr(eq + 1);
+  if (name == "--restart") {
+    if (value == "luby") {
+      options.restart = RestartKind::Luby;
+    } else if (value == "geometric") {
+      options.restart = RestartKind::Geometric;
+    } else if (value == "glucose") {
+      options.restart = RestartKind::Glucose;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--mode") {
+    if (value == "focused") {
+      options.mode = SearchMode::Focused;
+    } else if (value == "stable") {
+      options.mode = SearchMode::Stable;
+    } else if (value == "switch") {
+      options.mode = SearchMode::Switch;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--decide") {
+    if (value == "evsids") {
+      options.decision = DecisionKind::Evsids;
+    } else if (value == "vmtf") {
+      options.decision = DecisionKind::Vmtf;
+    } else if (value == "auto") {
+      options.decision = DecisionKind::Auto;
+    } else if (value == "lrb") {
+      options.decision = DecisionKind::Lrb;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--rephase") {
+    if (value == "on") {
+      options.rephase = true;
+    } else if (value == "off") {
+      options.rephase = false;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--preprocess") {
+    if (value == "on") {
+      options.preprocess = true;
+    } else if (value == "off") {
+      options.preprocess = false;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--inprocess") {
+    if (value == "on") {
+      options.inprocess = true;
+    } else if (value == "off") {
+      options.inprocess = false;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--vivify") {
+    if (value == "on") {
+      options.vivify = true;
+    } else if (value == "off") {
+      options.vivify = false;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--seed") {
+    const std::optional<uint64_t> seed = parse_uint(value);
+    if (!seed) {
+      return false;
+    }
+    options.seed = seed.value();
+    return true;
+  }
+  if (name == "--threads") {
+    const std::optional<uint64_t> n = parse_uint(value);
+    if (!n || n.value() == 0) {
+      return false;
+    }
+    parallel.threads = static_cast<size_t>(n.value());
+    return true;
+  }
+  if (name == "--processes") {
+    const std::optional<uint64_t> n = parse_uint(value);
+    if (!n || n.value() == 0) {
+      return false;
+    }
+    parallel.processes = static_cast<size_t>(n.value());
+    return true;
+  }
+  if (name == "--cubes") {
+    const std::optional<uint64_t> depth = parse_uint(value);
+    if (!depth) {
+      return false;
+    }
+    parallel.cube_depth = static_cast<size_t>(depth.value());
+    return true;
+  }
+  if (name == "--proof") {
+    if (value.empty()) {
+      return false;
+    }
+    proof.path = value;
+    return true;
+  }
+  if (name == "--proof-format") {
+    if (value == "drat") {
+      proof.format = ProofFormat::Drat;
+    } else if (value == "binary") {
+      proof.format = ProofFormat::BinaryDrat;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--stats") {
+    if (value == "on") {
+      stats = true;
+    } else if (value == "off") {
+      stats = false;
+    } else {
+      return false;
+    }
+    return true;
+  }
+  if (name == "--conflicts") {
+    budget.conflicts = parse_uint(value);
+    return budget.conflicts.has_value();
+  }
+  if (name == "--time") {
+    char *end = nullptr;
+    errno = 0;
+    const double seconds = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || errno != 0 || !(seconds >= 0.0)) {
+      return false;
+    }
+    budget.seconds = seconds;
+    return true;
+  }
+  return false;
+}
+
+// Stop the solver on SIGINT/SIGTERM and report UNKNOWN.
+void *running_solver = nullptr;
+void (*interrupt_solver)(void *) = nullptr;
+Portfolio *running_portfolio = nullptr;
+CubeAndConquer *running_cubes = nullptr;
+Coordinator *running_coordinator = nullptr;
+void handle_signal(int) {
+  if (running_solver) {
+    interrupt_solver(running_solver);
+  }
+  if (running_portfolio) {
+    running_portfolio->interrupt();
+  }
+  if (running_cubes) {
+    running_cubes->interrupt();
+  }
+  if (running_coordinator) {
+    running_coordinator->interrupt();
+  }
+}
+
+// Configurations of the single solver. A fixed heuristic or restart policy
+// takes its branches out of the search loop, and the CLI never solves under
+// assumptions.
+struct CliTraits : DefaultTraits {
+  static constexpr bool assumptions = false;
+  static constexpr bool proof = false;
+};
+template <DecisionKind D> struct FixedTraits : CliTraits {
+  static constexpr std::optional<DecisionKind> decision = D;
+  static constexpr std::optional<RestartKind> restart = RestartKind::Glucose;
+};
+struct ProofTraits : CliTraits {
+  static constexpr bool proof = true;
+};
+struct StatsTraits : CliTraits {
+  static constexpr bool stats = true;
+};
+
+// Solve cnf by a solver with the traits and log the proof to writer.
+template <class Traits>
+Status run_solver(CnfData cnf, const Options &options, const Budget &budget,
+                  ProofWriter *writer, std::vector<bool> &model) {
+  BasicSolver<Traits> solver;
+  solver.options = options;
+  solver.budget = budget;
+  solver.set_proof(writer);
+  solver.load(std::move(cnf));
+  interrupt_solver = [](void *running) {
+    static_cast<BasicSolver<Traits> *>(running)->interrupt();
+  };
+  running_solver = &solver;
+  const Status status = solver.solve();
+  running_solver = nullptr;
+  model = std::move(solver.model);
+  if constexpr (Traits::stats) {
+    const Statistics &stats = solver.stats();
+    std::cerr << "c conflicts: " << solver.num_conflicts() << "\n"
+              << "c decisions: " << stats.decisions << "\n"
+              << "c learnt units: " << stats.learnt_units << "\n"
+              << "c learnt binaries: " << stats.learnt_binaries << "\n"
+              << "c learnt literals: " << stats.learnt_literals << "\n"
+              << "c minimized literals: " << stats.minimized_literals << "\n"
+              << "c reductions: " << stats.reductions << "\n"
+              << "c reduced learnts: " << stats.reduced_learnts << std::endl;
+  }
+  return status;
+}
+
+void write_result(const std::vector<bool> &model, Status status,
+                  std::ostream &os, bool tostdout) {
   std::string result;
   if (status == Status::Sat) {
     result = "SAT";
@@ -27,8 +324,8 @@ void write_result(const Solver &solver, Status status, std::ostream &os,
   }
   if (status == Status::Sat) {
     std::string assigns = "";
-    for (size_t v = 0; v < solver.assings.size(); v++) {
-      if (solver.assings[v]) {
+    for (size_t v = 0; v < model.size(); v++) {
+      if (model[v]) {
         assigns += std::to_string(v + 1) + " ";
       } else {
         assigns += "-" + std::to_string(v + 1) + " ";
@@ -39,25 +336,129 @@ void write_result(const Solver &solver, Status status, std::ostream &os,
   }
 }
 int main(int argc, char *argv[]) {
-  if (!(argc == 2 || argc == 3)) {
+  Options options;
+  Budget budget;
+  Parallel parallel;
+  ProofOutput proof;
+  bool stats = false;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      if (!parse_option(arg, options, budget, parallel, proof, stats)) {
+        std::cerr << "c error: unknown option " << arg << std::endl;
+        help();
+        std::exit(1);
+      }
+    } else {
+      files.push_back(arg);
+    }
+  }
+  if (!(files.size() == 1 || files.size() == 2)) {
     help();
     std::exit(1);
   }
-  std::ifstream input(argv[1]);
-  auto cnf = bullsat::parse_cnf(input);
-  Solver solver;
-  if (cnf.var_num) {
-    solver = Solver(cnf.var_num.value());
+  const bool single = parallel.threads == 1 && parallel.processes == 1 &&
+                      !parallel.cube_depth;
+  if (proof.path && !single) {
+    std::cerr << "c error: --proof works with a single solver" << std::endl;
+    std::exit(1);
+  }
+  if (stats && !single) {
+    std::cerr << "c error: --stats works with a single solver" << std::endl;
+    std::exit(1);
+  }
+  if (stats && proof.path) {
+    // the proof solver is compiled without the counters
+    std::cerr << "c error: --stats does not work with --proof" << std::endl;
+    std::exit(1);
+  }
+  CnfData cnf;
+  try {
+    cnf = bullsat::parse_cnf_file(files[0]);
+  } catch (const std::exception &e) {
+    std::cerr << "c error: " << files[0] << ": " << e.what() << std::endl;
+    std::exit(1);
+  }
+  std::signal(SIGINT, handle_signal);
+  std::signal(SIGTERM, handle_signal);
+  Status status;
+  std::vector<bool> model;
+  if (parallel.processes > 1) {
+    Coordinator coordinator(parallel.processes, options);
+    running_coordinator = &coordinator;
+    try {
+      status = coordinator.solve(cnf, parallel.cube_depth, budget);
+    } catch (const std::exception &e) {
+      std::cerr << "c error: " << e.what() << std::endl;
+      std::exit(1);
+    }
+    running_coordinator = nullptr;
+    if (coordinator.num_restarts() > 0) {
+      std::cerr << "c restarted " << coordinator.num_restarts()
+                << " crashed workers" << std::endl;
+    }
+    model = std::move(coordinator.model);
+  } else if (parallel.cube_depth) {
+    CubeAndConquer cubes(parallel.threads, options);
+    running_cubes = &cubes;
+    status = cubes.solve(cnf, parallel.cube_depth.value(), budget);
+    running_cubes = nullptr;
+    model = std::move(cubes.model);
+  } else if (parallel.threads > 1) {
+    // the parsed formula is shared by the solvers
+    Portfolio portfolio(parallel.threads, options);
+    running_portfolio = &portfolio;
+    status = portfolio.solve(cnf, budget);
+    running_portfolio = nullptr;
+    model = std::move(portfolio.model);
+  } else {
+    std::unique_ptr<ProofWriter> writer;
+    int proof_fd = -1;
+    if (proof.path) {
+      proof_fd = ::open(proof.path->c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                        0644);
+      if (proof_fd < 0) {
+        std::cerr << "c error: " << proof.path.value() << ": "
+                  << std::strerror(errno) << std::endl;
+        std::exit(1);
+      }
+      writer = std::make_unique<ProofWriter>(proof_fd, proof.format);
+    }
+    const bool fixed = options.restart == RestartKind::Glucose;
+    if (writer) {
+      status = run_solver<ProofTraits>(std::move(cnf), options, budget,
+                                       writer.get(), model);
+    } else if (stats) {
+      status = run_solver<StatsTraits>(std::move(cnf), options, budget,
+                                       nullptr, model);
+    } else if (fixed && options.decision == DecisionKind::Evsids) {
+      status = run_solver<FixedTraits<DecisionKind::Evsids>>(
+          std::move(cnf), options, budget, nullptr, model);
+    } else if (fixed && options.decision == DecisionKind::Vmtf) {
+      status = run_solver<FixedTraits<DecisionKind::Vmtf>>(
+          std::move(cnf), options, budget, nullptr, model);
+    } else if (fixed && options.decision == DecisionKind::Lrb) {
+      status = run_solver<FixedTraits<DecisionKind::Lrb>>(
+          std::move(cnf), options, budget, nullptr, model);
+    } else {
+      status = run_solver<CliTraits>(std::move(cnf), options, budget, nullptr,
+                                     model);
+    }
+    if (writer) {
+      if (!writer->flush()) {
+        std::cerr << "c error: " << proof.path.value() << ": "
+                  << std::strerror(errno) << std::endl;
+      }
+      writer.reset();
+      ::close(proof_fd);
+    }
   }
-  auto clauses = cnf.clauses;
-  std::for_each(clauses.begin(), clauses.end(),
-                [&](const Clause &clause) { solver.add_clause(clause); });
-  Status status = solver.solve();
 
-  if (argc == 3) {
-    std::ofstream ofs(argv[2]);
-    write_result(solver, status, ofs, false);
+  if (files.size() == 2) {
+    std::ofstream ofs(files[1]);
+    write_result(model, status, ofs, false);
   } else {
-    write_result(solver, status, std::cout, true);
+    write_result(model, status, std::cout, true);
   }
 }
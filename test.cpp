@@ -1,6 +1,10 @@
+// the proof logging of the solver is tested too
+#define BULLSAT_PROOF
 #include "bullsat.hpp"
 #include <algorithm>
 #include <cassert>
+#include <csignal>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -13,6 +17,51 @@ void test_start(const char *funcname) {
        << " ==================== " << endl;
 }
 
+// The pigeonhole principle: holes + 1 pigeons don't fit in the holes.
+// It is unsatisfiable and needs many conflicts.
+// An activation literal makes it conditional.
+void add_pigeonhole(Solver &solver, int holes,
+                    std::optional<Lit> activation = std::nullopt) {
+  auto var = [&](int p, int h) { return Var(p * holes + h); };
+  for (int p = 0; p <= holes; p++) {
+    Clause clause;
+    if (activation) {
+      clause.push_back(~activation.value());
+    }
+    for (int h = 0; h < holes; h++) {
+      clause.push_back(Lit(var(p, h), true));
+    }
+    solver.add_clause(clause);
+  }
+  for (int h = 0; h < holes; h++) {
+    for (int p = 0; p <= holes; p++) {
+      for (int q = p + 1; q <= holes; q++) {
+        solver.add_clause({Lit(var(p, h), false), Lit(var(q, h), false)});
+      }
+    }
+  }
+}
+
+// The pigeonhole principle in DIMACS CNF.
+string pigeonhole_cnf(int holes) {
+  std::ostringstream out;
+  out << "p cnf " << (holes + 1) * holes << " 0\n";
+  for (int p = 0; p <= holes; p++) {
+    for (int h = 0; h < holes; h++) {
+      out << p * holes + h + 1 << " ";
+    }
+    out << "0\n";
+  }
+  for (int h = 0; h < holes; h++) {
+    for (int p = 0; p <= holes; p++) {
+      for (int q = p + 1; q <= holes; q++) {
+        out << -(p * holes + h + 1) << " " << -(q * holes + h + 1) << " 0\n";
+      }
+    }
+  }
+  return out.str();
+}
+
 void test_lit() {
   test_start(__func__);
   Lit x0 = Lit(0, true); // x0
@@ -83,7 +132,7 @@ void test_propagate() {
 
     auto confl = solver.propagate();
     assert(confl.has_value());
-    Clause &clause = *confl.value();
+    Clause clause = solver.lits(confl.value());
     std::sort(clause.begin(), clause.end());
     assert(clause[0] == Lit(0, false));
     assert(clause[1] == Lit(1, false));
@@ -170,10 +219,31 @@ void test_analyze() {
 
     auto [learnt_clause, level] = solver.analyze(confl.value());
     assert(learnt_clause.size() == 3 && level == 2);
-    // (!x1 v !x5 v !x6)
-    Clause l = Clause{Lit(1, false), Lit(5, false), Lit(6, false)};
+    // (!x1 v !x6 v !x5)
+    // the literal of the back jump level is the second.
+    Clause l = Clause{Lit(1, false), Lit(6, false), Lit(5, false)};
     assert(learnt_clause == l);
   }
+  {
+    // minimization
+    // @1: x0 -> x1
+    // @2: x2 -> x3 -> x4 -> conflict
+    Solver solver = Solver(5);
+    solver.add_clause(Clause{Lit(0, false), Lit(1, true)});
+    solver.add_clause(Clause{Lit(2, false), Lit(3, true)});
+    solver.add_clause(
+        Clause{Lit(3, false), Lit(0, false), Lit(1, false), Lit(4, true)});
+    solver.add_clause(Clause{Lit(3, false), Lit(4, false)});
+    solver.new_decision(Lit(0, true));
+    assert(!solver.propagate().has_value());
+    solver.new_decision(Lit(2, true));
+    auto confl = solver.propagate();
+    assert(confl.has_value());
+    auto [learnt_clause, level] = solver.analyze(confl.value());
+    // (!x3 v !x0 v !x1) is minimized because x0 implies x1.
+    assert(level == 1);
+    assert(learnt_clause == (Clause{Lit(3, false), Lit(0, false)}));
+  }
 }
 
 void test_queue() {
@@ -208,7 +278,7 @@ bool validate_satisfiable(const vector<Clause> &clauses, const Solver &solver) {
   for (const auto &clause : clauses) {
     bool satisfied = false;
     for (const auto &lit : clause) {
-      if (solver.eval(lit) == LitBool::True) {
+      if (solver.model[lit.vidx()] == lit.pos()) {
         satisfied = true;
         break;
       }
@@ -251,6 +321,34 @@ void test_solve() {
   }
 }
 
+void test_load() {
+  test_start(__func__);
+  {
+    // x2 and (x0 v x1 v x1) and (x0 v !x0 v x1) and (!x2 v !x0 v x3)
+    // and (!x1 v !x3)
+    std::istringstream in("p cnf 4 5\n3 0\n1 2 2 0\n1 -1 2 0\n-3 -1 4 0\n"
+                          "-2 -4 0\n");
+    CnfData data = parse_cnf(in);
+    vector<Clause> clauses;
+    for (size_t i = 0; i < data.num_clauses(); i++) {
+      clauses.push_back(data.clause(i));
+    }
+    Solver solver;
+    solver.load(std::move(data));
+    assert(solver.num_vars() == 4);
+    assert(solver.eval(Lit(2, true)) == LitBool::True);
+    assert(solver.solve() == Status::Sat);
+    assert(validate_satisfiable(clauses, solver));
+  }
+  {
+    // an empty clause
+    std::istringstream in("p cnf 2 2\n1 2 0\n0\n");
+    Solver solver;
+    solver.load(parse_cnf(in));
+    assert(solver.solve() == Status::Unsat);
+  }
+}
+
 void test_parse_cnf() {
   test_start(__func__);
 
@@ -272,7 +370,66 @@ void test_parse_cnf() {
                             Clause{Lit(1, false), Lit(2, false)},
                             Clause{Lit(0, true), Lit(1, true), Lit(2, false)},
                             Clause{Lit(0, true), Lit(2, true)}};
-  assert(data.clauses == clauses);
+  assert(data.num_clauses() == clauses.size());
+  for (size_t i = 0; i < clauses.size(); i++) {
+    assert(data.clause(i) == clauses[i]);
+  }
+  {
+    // a clause can span lines and the last 0 is optional
+    std::istringstream in("c comment\np cnf 3 2\n1 -2\n 3 0 -1 2");
+    CnfData d = parse_cnf(in);
+    assert(d.num_clauses() == 2);
+    assert(d.clause(0) == (Clause{Lit(0, true), Lit(1, false), Lit(2, true)}));
+    assert(d.clause(1) == (Clause{Lit(0, false), Lit(1, true)}));
+  }
+  {
+    // malformed input reports its line
+    std::istringstream in("p cnf 2 1\n1 2 0\n1 x 0\n");
+    bool thrown = false;
+    try {
+      parse_cnf(in);
+    } catch (const ParseError &e) {
+      thrown = true;
+      assert(e.line == 3);
+    }
+    assert(thrown);
+  }
+}
+
+void test_compressed_input() {
+  test_start(__func__);
+  using Block = InputSource::Block;
+  assert(detect_compression(Block("\x1f\x8b\x08", 3)) == Compression::Gzip);
+  assert(detect_compression(Block("\xfd" "7zXZ\x00\x00", 7)) ==
+         Compression::Xz);
+  assert(detect_compression(Block("BZh9", 4)) == Compression::Bzip2);
+  assert(detect_compression(Block("p cnf 1 1", 9)) == Compression::None);
+  assert(detect_compression(Block("", 0)) == Compression::None);
+#ifdef BULLSAT_ZLIB
+  {
+    const std::string cnf = "p cnf 2 2\n1 -2 0\n2 0\n";
+    z_stream stream = {};
+    // 15 + 16: gzip format
+    int ret = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+                           8, Z_DEFAULT_STRATEGY);
+    assert(ret == Z_OK);
+    std::string gz(deflateBound(&stream, cnf.size()), '\0');
+    stream.next_in = reinterpret_cast<const Bytef *>(cnf.data());
+    stream.avail_in = static_cast<uInt>(cnf.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&gz[0]);
+    stream.avail_out = static_cast<uInt>(gz.size());
+    ret = deflate(&stream, Z_FINISH);
+    assert(ret == Z_STREAM_END);
+    gz.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    std::istringstream in(gz);
+    CnfData data = parse_cnf(in);
+    assert(data.num_clauses() == 2);
+    assert(data.clause(0) == (Clause{Lit(0, true), Lit(1, false)}));
+    assert(data.clause(1) == (Clause{Lit(1, true)}));
+  }
+#endif
 }
 
 void test_heap() {
@@ -296,14 +453,869 @@ void test_heap() {
   }
 }
 
+void test_vmtf() {
+  test_start(__func__);
+  Vmtf vmtf;
+  for (Var v = 0; v < 4; v++) {
+    vmtf.push(v);
+  }
+  std::vector<bool> assigned(4, false);
+  auto is_assigned = [&](Var v) { return assigned[static_cast<size_t>(v)]; };
+  // the last enqueued variable first
+  assert(vmtf.next_unassigned(is_assigned) == Var(3));
+  assigned[3] = true;
+  assert(vmtf.next_unassigned(is_assigned) == Var(2));
+  assigned[2] = true;
+  // 1 moves to the front
+  vmtf.bump(1);
+  assert(vmtf.last == 1 && vmtf.first == 0);
+  assert(vmtf.prev[1] == 3 && vmtf.next[3] == 1);
+  vmtf.update(1);
+  assert(vmtf.next_unassigned(is_assigned) == Var(1));
+  assigned[1] = true;
+  assert(vmtf.next_unassigned(is_assigned) == Var(0));
+  assigned[0] = true;
+  assert(!vmtf.next_unassigned(is_assigned));
+  // unassigned again
+  assigned[2] = false;
+  vmtf.update(2);
+  assert(vmtf.next_unassigned(is_assigned) == Var(2));
+
+  for (const auto kind :
+       {DecisionKind::Evsids, DecisionKind::Vmtf, DecisionKind::Auto}) {
+    std::ifstream file("./cnf/unsat.cnf");
+    Solver solver;
+    solver.options.decision = kind;
+    solver.load(parse_cnf(file));
+    assert(solver.solve() == Status::Unsat);
+  }
+}
+
+void test_lrb() {
+  test_start(__func__);
+  for (const string path : {"./cnf/sat.cnf", "./cnf/unsat.cnf"}) {
+    std::ifstream file(path);
+    Solver solver;
+    solver.options.decision = DecisionKind::Lrb;
+    solver.load(parse_cnf(file));
+    const Status expected =
+        path == "./cnf/sat.cnf" ? Status::Sat : Status::Unsat;
+    assert(solver.solve() == expected);
+  }
+  {
+    Solver solver;
+    solver.options.decision = DecisionKind::Lrb;
+    add_pigeonhole(solver, 5);
+    assert(solver.solve() == Status::Unsat);
+  }
+}
+
+void test_clause_arena() {
+  test_start(__func__);
+  ClauseArena arena;
+  Clause c0 = Clause{Lit(0, true), Lit(1, false)};
+  Clause c1 = Clause{Lit(2, true), Lit(3, true), Lit(4, false)};
+  CRef cr0 = arena.alloc(c0, false);
+  CRef cr1 = arena.alloc(c1, true);
+  assert(arena.size() == ClauseArena::words(2) + ClauseArena::words(3));
+  assert(!arena[cr0].learnt() && arena[cr1].learnt());
+  assert(Clause(arena[cr1].begin(), arena[cr1].end()) == c1);
+
+  // drop c0 and compact the rest
+  arena[cr0].mark_deleted();
+  arena.free(cr0);
+  assert(arena.wasted() == ClauseArena::words(2));
+  ClauseArena to;
+  CRef moved = cr1;
+  arena.reloc(moved, to);
+  assert(moved == 0 && to.size() == ClauseArena::words(3));
+  // another reference to the same clause follows the forwarding reference
+  CRef other = cr1;
+  arena.reloc(other, to);
+  assert(other == moved);
+  assert(Clause(to[moved].begin(), to[moved].end()) == c1);
+  assert(to[moved].learnt());
+}
+
+void test_restart() {
+  test_start(__func__);
+  {
+    vector<double> seq;
+    for (uint64_t i = 0; i < 15; i++) {
+      seq.push_back(luby(2, i));
+    }
+    assert(seq == (vector<double>{1, 1, 2, 1, 1, 2, 4, 1, 1, 2, 1, 1, 2, 4, 8}));
+  }
+  {
+    // 10, 10, 20, ... conflicts
+    LubyRestart restart(10);
+    for (int i = 0; i < 10; i++) {
+      assert(!restart.should_restart());
+      restart.on_conflict(3);
+    }
+    assert(restart.should_restart());
+    restart.on_restart();
+    assert(!restart.should_restart());
+  }
+  {
+    GlucoseRestart restart;
+    for (int i = 0; i < 1000; i++) {
+      restart.on_conflict(5);
+    }
+    assert(!restart.should_restart());
+    // the recent LBDs get worse
+    for (int i = 0; i < 10; i++) {
+      restart.on_conflict(20);
+    }
+    assert(restart.should_restart());
+    restart.on_restart();
+    assert(!restart.should_restart());
+  }
+  {
+    // every mode and policy solves
+    for (const auto mode :
+         {SearchMode::Focused, SearchMode::Stable, SearchMode::Switch}) {
+      for (const auto kind :
+           {RestartKind::Luby, RestartKind::Geometric, RestartKind::Glucose}) {
+        std::ifstream file("./cnf/unsat.cnf");
+        Solver solver;
+        solver.options.mode = mode;
+        solver.options.restart = kind;
+        solver.load(parse_cnf(file));
+        assert(solver.solve() == Status::Unsat);
+      }
+    }
+  }
+}
+
+void test_rephase() {
+  test_start(__func__);
+  {
+    Random a(1), b(1), c(2);
+    for (int i = 0; i < 100; i++) {
+      const uint64_t x = a.next();
+      assert(x == b.next());
+      assert(x != c.next());
+    }
+    for (int i = 0; i < 100; i++) {
+      assert(a.below(7) < 7);
+      const double r = a.real();
+      assert(0.0 <= r && r < 1.0);
+    }
+  }
+  // planted random 3-SAT and the pigeonhole principle (8 pigeons, 7 holes)
+  // need enough conflicts to go through the rephasing schedule including
+  // local search.
+  auto planted = [](Solver &solver, Random &rng) {
+    const size_t n = 150;
+    std::vector<bool> plant(n);
+    for (size_t i = 0; i < n; i++) {
+      plant[i] = rng.next() & 1;
+    }
+    for (size_t c = 0; c < 4 * n; c++) {
+      Clause clause;
+      bool sat = false;
+      while (!sat) {
+        clause.clear();
+        for (int k = 0; k < 3; k++) {
+          const Var v = static_cast<Var>(rng.below(n));
+          const bool sign = rng.next() & 1;
+          clause.push_back(Lit(v, sign));
+          sat |= plant[static_cast<size_t>(v)] == sign;
+        }
+      }
+      solver.add_clause(clause);
+    }
+  };
+  for (const bool rephase : {false, true}) {
+    for (const auto mode : {SearchMode::Stable, SearchMode::Switch}) {
+      {
+        Random rng(42);
+        Solver solver(150);
+        solver.options.rephase = rephase;
+        solver.options.mode = mode;
+        planted(solver, rng);
+        assert(solver.solve() == Status::Sat);
+      }
+      {
+        Solver solver;
+        solver.options.rephase = rephase;
+        solver.options.mode = mode;
+        solver.options.seed = 7;
+        add_pigeonhole(solver, 7);
+        assert(solver.solve() == Status::Unsat);
+      }
+    }
+  }
+}
+
+void test_budget() {
+  test_start(__func__);
+  {
+    // resume search within 100 conflicts each
+    Solver solver;
+    add_pigeonhole(solver, 7);
+    solver.budget.conflicts = 100;
+    Status status = Status::Unknown;
+    int calls = 0;
+    for (; status == Status::Unknown; calls++) {
+      const uint64_t conflicts = solver.num_conflicts();
+      status = solver.solve();
+      assert(solver.num_conflicts() <= conflicts + 100);
+    }
+    assert(status == Status::Unsat && calls > 1);
+  }
+  {
+    Solver solver;
+    add_pigeonhole(solver, 7);
+    solver.budget.propagations = 1000;
+    assert(solver.solve() == Status::Unknown);
+    assert(solver.num_propagations() >= 1000);
+    solver.budget = Budget{};
+    solver.budget.ticks = 1000;
+    assert(solver.solve() == Status::Unknown);
+    solver.budget = Budget{};
+    solver.budget.seconds = 0.0;
+    assert(solver.solve() == Status::Unknown);
+    solver.budget = Budget{};
+    solver.interrupt();
+    assert(solver.solve() == Status::Unknown);
+    solver.clear_interrupt();
+    assert(solver.solve() == Status::Unsat);
+  }
+}
+
+void test_incremental() {
+  test_start(__func__);
+  // (x0 v x1) and (!x1 v x2) and (!x2 v x3)
+  Solver solver(4);
+  vector<Clause> clauses = {Clause{Lit(0, true), Lit(1, true)},
+                            Clause{Lit(1, false), Lit(2, true)},
+                            Clause{Lit(2, false), Lit(3, true)}};
+  for (const Clause &clause : clauses) {
+    solver.add_clause(clause);
+  }
+  // later clauses and assumptions use every variable
+  for (Var v = 0; v < 4; v++) {
+    solver.freeze(v);
+  }
+  assert(solver.solve({Lit(0, false)}) == Status::Sat);
+  assert(validate_satisfiable(clauses, solver));
+  assert(solver.model[0] == false && solver.model[3] == true);
+
+  // x2 -> x3
+  assert(solver.solve({Lit(2, true), Lit(0, false), Lit(3, false)}) ==
+         Status::Unsat);
+  vector<Lit> failed = solver.failed_assumptions;
+  std::sort(failed.begin(), failed.end());
+  assert(failed == (vector<Lit>{Lit(2, true), Lit(3, false)}));
+
+  // !x0 -> x1 -> x2 -> x3
+  assert(solver.solve({Lit(3, false), Lit(0, false)}) == Status::Unsat);
+  failed = solver.failed_assumptions;
+  std::sort(failed.begin(), failed.end());
+  assert(failed == (vector<Lit>{Lit(0, false), Lit(3, false)}));
+
+  // contradicting assumptions
+  assert(solver.solve({Lit(1, true), Lit(1, false)}) == Status::Unsat);
+  failed = solver.failed_assumptions;
+  std::sort(failed.begin(), failed.end());
+  assert(failed == (vector<Lit>{Lit(1, true), Lit(1, false)}));
+
+  // The formula is still satisfiable and gets a new clause and variable.
+  assert(solver.solve() == Status::Sat);
+  assert(solver.failed_assumptions.empty());
+  clauses.push_back(Clause{Lit(3, false), Lit(4, true)});
+  solver.add_clause(clauses.back());
+  assert(solver.solve({Lit(4, false), Lit(0, false)}) == Status::Unsat);
+  failed = solver.failed_assumptions;
+  std::sort(failed.begin(), failed.end());
+  assert(failed == (vector<Lit>{Lit(0, false), Lit(4, false)}));
+  assert(solver.solve({Lit(1, true)}) == Status::Sat);
+  assert(validate_satisfiable(clauses, solver));
+
+  // a unit clause makes an assumption false at the top level
+  solver.add_clause({Lit(0, true)});
+  assert(solver.solve({Lit(0, false), Lit(1, false)}) == Status::Unsat);
+  assert(solver.failed_assumptions == (vector<Lit>{Lit(0, false)}));
+  solver.add_clause({Lit(1, true)});
+  solver.add_clause({Lit(4, false)});
+  assert(solver.solve() == Status::Unsat);
+  assert(solver.solve({Lit(1, true)}) == Status::Unsat);
+  assert(solver.failed_assumptions.empty());
+
+  {
+    // (x3 v x0) (!x3 v x1) (x0 v x2): x3 is eliminated by the first solve()
+    Solver elim;
+    elim.add_clause({Lit(3, true), Lit(0, true)});
+    elim.add_clause({Lit(3, false), Lit(1, true)});
+    elim.add_clause({Lit(0, true), Lit(2, true)});
+    assert(elim.solve({Lit(0, true), Lit(1, true)}) == Status::Sat);
+    assert(elim.is_eliminated(3));
+    elim.freeze(3);
+    bool thrown = false;
+    try {
+      elim.add_clause({Lit(3, false)});
+    } catch (const std::invalid_argument &) {
+      thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    try {
+      elim.solve({Lit(3, false)});
+    } catch (const std::invalid_argument &) {
+      thrown = true;
+    }
+    assert(thrown);
+    assert(elim.solve() == Status::Sat);
+  }
+  {
+    // The pigeonhole principle is activated by an assumption and the learnt
+    // clauses are kept for the next query.
+    const int holes = 6;
+    Solver php;
+    // a pigeon can stay out of the holes if !a
+    const Lit a = Lit((holes + 1) * holes, true);
+    add_pigeonhole(php, holes, a);
+    assert(php.solve({a}) == Status::Unsat);
+    assert(php.failed_assumptions == (vector<Lit>{a}));
+    const uint64_t conflicts = php.num_conflicts();
+    assert(php.solve({a}) == Status::Unsat);
+    assert(php.num_conflicts() - conflicts < conflicts);
+    assert(php.solve({~a}) == Status::Sat);
+    assert(php.solve() == Status::Sat);
+  }
+}
+
+void test_eliminator() {
+  test_start(__func__);
+  {
+    // (x0 v x1) subsumes (x0 v x1 v x2)
+    // (!x0 v x1) strengthens (x0 v x1) to (x1)
+    Eliminator eliminator(3, vector<bool>(3, true));
+    eliminator.add_clause({Lit(0, true), Lit(1, true)});
+    eliminator.add_clause({Lit(0, true), Lit(1, true), Lit(2, true)});
+    eliminator.add_clause({Lit(0, false), Lit(1, true)});
+    eliminator.add_clause({Lit(0, true), Lit(2, false), Lit(1, false)});
+    assert(eliminator.run(1000000));
+    // x1 satisfies the rest and (x0 v !x2 v !x1) becomes (x0 v !x2)
+    assert(eliminator.units() == (vector<Lit>{Lit(1, true)}));
+    assert(eliminator.clauses() ==
+           (vector<Clause>{{Lit(0, true), Lit(2, false)}}));
+  }
+  {
+    // (!x0 v x2) strengthens (!x0 v !x2 v x1) to (!x0 v x1), which
+    // strengthens (x0 v x1) to (x1). Then x0 only occurs in (!x0 v x2).
+    vector<bool> frozen = {false, true, true};
+    Eliminator eliminator(3, frozen);
+    eliminator.add_clause({Lit(0, true), Lit(1, true)});
+    eliminator.add_clause({Lit(0, false), Lit(2, true)});
+    eliminator.add_clause({Lit(0, false), Lit(2, false), Lit(1, true)});
+    assert(eliminator.run(1000000));
+    assert(eliminator.eliminated_vars() == (vector<bool>{true, false, false}));
+    assert(eliminator.units() == (vector<Lit>{Lit(1, true)}));
+    assert(eliminator.clauses().empty());
+    assert(eliminator.eliminated_offsets() == (vector<size_t>{0, 2}));
+    const vector<Lit> &lits = eliminator.eliminated_lits();
+    for (size_t i = 0; i + 1 < eliminator.eliminated_offsets().size(); i++) {
+      assert(lits[eliminator.eliminated_offsets()[i]].var() == 0);
+    }
+  }
+  {
+    // an empty resolvent
+    Eliminator eliminator(1, vector<bool>(1, false));
+    eliminator.add_clause({Lit(0, true)});
+    eliminator.add_clause({Lit(0, false)});
+    assert(!eliminator.run(1000000));
+  }
+  // models are extended to the eliminated variables
+  for (const string path :
+       {"./cnf/sat.cnf", "./cnf/benchmark/sat/sudoku_16.cnf",
+        "./cnf/benchmark/sat/uf250-027.cnf"}) {
+    std::ifstream file(path);
+    CnfData data = parse_cnf(file);
+    vector<Clause> clauses;
+    for (size_t i = 0; i < data.num_clauses(); i++) {
+      clauses.push_back(data.clause(i));
+    }
+    Solver solver;
+    solver.load(std::move(data));
+    assert(solver.solve() == Status::Sat);
+    assert(solver.model.size() == solver.num_vars());
+    assert(validate_satisfiable(clauses, solver));
+  }
+}
+
+void test_inprocess() {
+  test_start(__func__);
+  {
+    // x0 = x1 = x2 and x3 = !x4
+    vector<Clause> clauses = {{Lit(0, false), Lit(1, true)},
+                              {Lit(1, false), Lit(2, true)},
+                              {Lit(2, false), Lit(0, true)},
+                              {Lit(3, true), Lit(4, true)},
+                              {Lit(3, false), Lit(4, false)},
+                              {Lit(1, true), Lit(3, true), Lit(5, true)},
+                              {Lit(2, false), Lit(4, true), Lit(5, false)}};
+    Solver solver;
+    for (const Clause &clause : clauses) {
+      solver.add_clause(clause);
+    }
+    // x4 is the representative of x3
+    solver.freeze(4);
+    solver.substitute_equivalences();
+    assert(!solver.is_eliminated(0) && solver.is_eliminated(1) &&
+           solver.is_eliminated(2));
+    assert(solver.is_eliminated(3) && !solver.is_eliminated(4));
+    assert(solver.solve() == Status::Sat);
+    assert(validate_satisfiable(clauses, solver));
+  }
+  {
+    // x0 -> x1 -> !x0 and !x0 -> x2 -> x0
+    Solver solver;
+    solver.add_clause({Lit(0, false), Lit(1, true)});
+    solver.add_clause({Lit(1, false), Lit(0, false)});
+    solver.add_clause({Lit(0, true), Lit(2, true)});
+    solver.add_clause({Lit(2, false), Lit(0, true)});
+    solver.substitute_equivalences();
+    assert(solver.solve() == Status::Unsat);
+  }
+  {
+    // x0 -> x1, x2 -> x3 and !x3 fails
+    // !x5 -> !x4, !x6 and (x4 v x6) fails
+    Solver solver;
+    solver.add_clause({Lit(0, false), Lit(1, true)});
+    solver.add_clause({Lit(0, false), Lit(2, true)});
+    solver.add_clause({Lit(1, false), Lit(2, false), Lit(3, true)});
+    solver.add_clause({Lit(1, false), Lit(2, false), Lit(3, false)});
+    solver.add_clause({Lit(4, false), Lit(5, true)});
+    solver.add_clause({Lit(6, false), Lit(5, true)});
+    solver.add_clause({Lit(4, true), Lit(6, true)});
+    solver.probe();
+    assert(solver.eval(Lit(0, false)) == LitBool::True);
+    assert(solver.eval(Lit(5, true)) == LitBool::True);
+    assert(solver.decision_level() == 0);
+    assert(solver.solve() == Status::Sat);
+  }
+}
+
+void test_vivify() {
+  test_start(__func__);
+  {
+    // !x0 fails: (x0 v x1 v x2) is shortened to the unit x0
+    Solver solver;
+    solver.add_clause({Lit(0, true), Lit(1, true), Lit(2, true)});
+    solver.add_clause({Lit(0, true), Lit(3, true)});
+    solver.add_clause({Lit(0, true), Lit(3, false)});
+    solver.vivify();
+    assert(solver.eval(Lit(0, true)) == LitBool::True);
+    assert(solver.decision_level() == 0);
+  }
+  {
+    // !x0 -> x2: (x0 v x1 v x2 v x3) is shortened to (x0 v x2)
+    // !x1 -> !x2: (x1 v x2 v x3 v x4) is shortened to (x1 v x3 v x4)
+    Solver solver;
+    solver.add_clause({Lit(0, true), Lit(1, true), Lit(2, true), Lit(3, true)});
+    solver.add_clause({Lit(1, true), Lit(2, true), Lit(3, true), Lit(4, true)});
+    solver.add_clause({Lit(0, true), Lit(2, true)});
+    solver.add_clause({Lit(1, true), Lit(2, false)});
+    solver.vivify();
+    assert(solver.num_clauses() == 1);
+    assert(solver.solve() == Status::Sat);
+  }
+  {
+    Solver solver;
+    add_pigeonhole(solver, 6);
+    solver.options.preprocess = false;
+    solver.budget.conflicts = 200;
+    assert(solver.solve() == Status::Unknown);
+    solver.vivify();
+    assert(solver.decision_level() == 0);
+    solver.budget = Budget();
+    assert(solver.solve() == Status::Unsat);
+  }
+}
+
+void test_shared_ring() {
+  test_start(__func__);
+  SharedRing ring;
+  const Clause binary = {Lit(0, true), Lit(1, false)};
+  const Clause unit = {Lit(2, true)};
+  ring.push(binary.data(), binary.size(), 1);
+  ring.push(unit.data(), unit.size(), 0);
+  uint64_t cursor = 0;
+  Clause buffer;
+  vector<Clause> read;
+  ring.read(cursor, buffer, [&](Clause &clause, uint32_t) {
+    read.push_back(clause);
+  });
+  assert(cursor == 2);
+  assert(read.size() == 2 && read[0] == binary && read[1] == unit);
+  // nothing new
+  ring.read(cursor, buffer, [&](Clause &, uint32_t) { assert(false); });
+  // a reader that falls behind skips the overwritten clauses
+  for (int i = 0; i < (1 << 15); i++) {
+    ring.push(unit.data(), unit.size(), 0);
+  }
+  size_t count = 0;
+  ring.read(cursor, buffer, [&](Clause &, uint32_t) { count++; });
+  assert(count == (1 << 14));
+}
+
+void test_portfolio() {
+  test_start(__func__);
+  // every diversified configuration is a valid one
+  for (size_t i = 0; i < 16; i++) {
+    const Options options = diversify(Options(), i);
+    assert(options.var_decay > 0.0 && options.var_decay < 1.0);
+    assert(i == 0 || options.seed == i);
+  }
+  {
+    std::ifstream file("./cnf/benchmark/sat/uf250-027.cnf");
+    const CnfData data = parse_cnf(file);
+    vector<Clause> clauses;
+    for (size_t i = 0; i < data.num_clauses(); i++) {
+      clauses.push_back(data.clause(i));
+    }
+    Portfolio portfolio(4, Options());
+    assert(portfolio.size() == 4);
+    assert(portfolio.solve(data) == Status::Sat);
+    assert(portfolio.winner.has_value());
+    const Solver &winner = portfolio.solver(portfolio.winner.value());
+    assert(validate_satisfiable(clauses, winner));
+    assert(portfolio.model == winner.model);
+  }
+  {
+    // the solvers exchange learnt clauses
+    std::istringstream in(pigeonhole_cnf(7));
+    Portfolio portfolio(2, Options());
+    assert(portfolio.solve(parse_cnf(in)) == Status::Unsat);
+    uint64_t exported = 0;
+    for (size_t i = 0; i < portfolio.size(); i++) {
+      exported += portfolio.solver(i).num_exported();
+    }
+    assert(exported > 0);
+  }
+  {
+    std::istringstream in("p cnf 1 2\n1 0\n-1 0\n");
+    Portfolio portfolio(3, Options());
+    assert(portfolio.solve(parse_cnf(in)) == Status::Unsat);
+    // the next call solves its own formula
+    std::istringstream sat("p cnf 2 2\n1 2 0\n-1 2 0\n");
+    assert(portfolio.solve(parse_cnf(sat)) == Status::Sat);
+    assert(portfolio.model[1]);
+  }
+  {
+    // a budget too small for the pigeonhole principle
+    std::istringstream in(pigeonhole_cnf(9));
+    Budget budget;
+    budget.conflicts = 100;
+    Portfolio portfolio(2, Options());
+    assert(portfolio.solve(parse_cnf(in), budget) == Status::Unknown);
+    assert(!portfolio.winner.has_value());
+  }
+}
+
+void test_cube_and_conquer() {
+  test_start(__func__);
+  {
+    // lookahead splits on the variables and drops refuted cubes
+    // (x0 v x1) and (!x0 v x1) and (x2 v x3 v x4)
+    Solver solver;
+    solver.add_clause({Lit(0, true), Lit(1, true)});
+    solver.add_clause({Lit(0, false), Lit(1, true)});
+    solver.add_clause({Lit(2, true), Lit(3, true), Lit(4, true)});
+    const vector<Clause> cubes = solver.cubes({}, 2);
+    assert(solver.decision_level() == 0);
+    // !x1 fails
+    assert(solver.eval(Lit(1, true)) == LitBool::True);
+    assert(cubes.size() == 4);
+    for (const Clause &cube : cubes) {
+      assert(cube.size() == 2);
+    }
+    // a refuted prefix has no cubes
+    assert(solver.cubes({Lit(1, false)}, 2).empty());
+    const vector<Clause> halves = solver.cubes({Lit(2, false)}, 1);
+    assert(halves.size() == 2 && halves[0][0] == Lit(2, false));
+  }
+  {
+    std::ifstream file("./cnf/benchmark/sat/uf250-027.cnf");
+    const CnfData data = parse_cnf(file);
+    vector<Clause> clauses;
+    for (size_t i = 0; i < data.num_clauses(); i++) {
+      clauses.push_back(data.clause(i));
+    }
+    CubeAndConquer cubes(3, Options());
+    assert(cubes.solve(data, 4) == Status::Sat);
+    assert(cubes.num_cubes() > 0);
+    for (const Clause &clause : clauses) {
+      bool satisfied = false;
+      for (const Lit lit : clause) {
+        satisfied |= cubes.model[lit.vidx()] == lit.pos();
+      }
+      assert(satisfied);
+    }
+  }
+  {
+    // cubes that are too hard are split again
+    std::istringstream in(pigeonhole_cnf(7));
+    CubeAndConquer cubes(2, Options());
+    cubes.cube_conflicts = 50;
+    assert(cubes.solve(parse_cnf(in), 2) == Status::Unsat);
+    assert(cubes.num_cubes() > 4);
+    // the next call solves its own formula
+    std::istringstream sat("p cnf 3 2\n1 2 0\n-1 3 0\n");
+    assert(cubes.solve(parse_cnf(sat), 2) == Status::Sat);
+    assert(cubes.model[0] ? cubes.model[2] : cubes.model[1]);
+  }
+  {
+    std::istringstream in(pigeonhole_cnf(9));
+    Budget budget;
+    budget.conflicts = 200;
+    CubeAndConquer cubes(2, Options());
+    assert(cubes.solve(parse_cnf(in), 2, budget) == Status::Unknown);
+  }
+}
+
+void test_coordinator() {
+  test_start(__func__);
+  {
+    std::ifstream file("./cnf/benchmark/sat/uf250-027.cnf");
+    const CnfData data = parse_cnf(file);
+    Coordinator coordinator(2, Options());
+    // the first worker is killed once
+    coordinator.on_worker_start = [](size_t id, size_t attempt) {
+      if (id == 0 && attempt == 0) {
+        std::raise(SIGKILL);
+      }
+    };
+    assert(coordinator.solve(data) == Status::Sat);
+    assert(coordinator.num_restarts() == 1);
+    for (size_t i = 0; i < data.num_clauses(); i++) {
+      bool satisfied = false;
+      for (const Lit lit : data.clause(i)) {
+        satisfied |= coordinator.model[lit.vidx()] == lit.pos();
+      }
+      assert(satisfied);
+    }
+  }
+  {
+    // every cube is refuted although workers keep crashing
+    std::istringstream in(pigeonhole_cnf(6));
+    Coordinator coordinator(3, Options());
+    coordinator.on_worker_start = [](size_t id, size_t attempt) {
+      if (id != 0 && attempt < 2) {
+        std::raise(SIGKILL);
+      }
+    };
+    assert(coordinator.solve(parse_cnf(in), 2) == Status::Unsat);
+    assert(coordinator.num_cubes() > 0);
+    assert(coordinator.num_restarts() >= 2);
+  }
+  {
+    // a job is given up after too many crashes
+    std::istringstream in(pigeonhole_cnf(6));
+    Coordinator coordinator(2, Options());
+    coordinator.on_worker_start = [](size_t, size_t) { std::raise(SIGKILL); };
+    assert(coordinator.solve(parse_cnf(in)) == Status::Unknown);
+  }
+  {
+    std::istringstream in(pigeonhole_cnf(9));
+    Budget budget;
+    budget.conflicts = 200;
+    Coordinator coordinator(2, Options());
+    assert(coordinator.solve(parse_cnf(in), std::nullopt, budget) ==
+           Status::Unknown);
+  }
+}
+
+// Write a proof to a temporary file and read it back.
+template <class F> string write_proof(ProofFormat format, F f) {
+  std::FILE *file = std::tmpfile();
+  assert(file != nullptr);
+  {
+    ProofWriter writer(fileno(file), format);
+    f(writer);
+  }
+  std::rewind(file);
+  string proof;
+  char buffer[4096];
+  size_t n = 0;
+  while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    proof.append(buffer, n);
+  }
+  std::fclose(file);
+  return proof;
+}
+
+// Check a textual DRAT proof of the formula: every added clause must be
+// implied by the clauses at that point and the empty clause must be added.
+void check_proof(const CnfData &cnf, const string &proof) {
+  vector<Clause> db;
+  for (size_t i = 0; i < cnf.num_clauses(); i++) {
+    db.push_back(cnf.clause(i));
+    std::sort(db.back().begin(), db.back().end());
+  }
+  std::istringstream in(proof);
+  string line;
+  bool refuted = false;
+  while (!refuted && std::getline(in, line)) {
+    std::istringstream words(line);
+    const bool deletion = line.compare(0, 2, "d ") == 0;
+    if (deletion) {
+      words.ignore(2);
+    }
+    Clause clause;
+    int x = 0;
+    while (words >> x && x != 0) {
+      clause.push_back(Lit(std::abs(x) - 1, x > 0));
+    }
+    std::sort(clause.begin(), clause.end());
+    if (deletion) {
+      const auto it = std::find(db.begin(), db.end(), clause);
+      assert(it != db.end());
+      db.erase(it);
+      continue;
+    }
+    Solver checker;
+    checker.options.preprocess = false;
+    checker.options.inprocess = false;
+    checker.options.vivify = false;
+    for (const Clause &c : db) {
+      checker.add_clause(c);
+    }
+    vector<Lit> negation;
+    for (const Lit lit : clause) {
+      negation.push_back(~lit);
+    }
+    assert(checker.solve(negation) == Status::Unsat);
+    db.push_back(clause);
+    refuted = clause.empty();
+  }
+  assert(refuted);
+}
+
+void test_proof() {
+  test_start(__func__);
+  {
+    const string text =
+        write_proof(ProofFormat::Drat, [](ProofWriter &writer) {
+          const Clause clause = {Lit(0, true), Lit(1, false)};
+          writer.add(clause.begin(), clause.end());
+          writer.remove(clause.begin() + 1, clause.end());
+          writer.add(clause.end(), clause.end());
+        });
+    assert(text == "1 -2 0\nd -2 0\n0\n");
+    const string binary =
+        write_proof(ProofFormat::BinaryDrat, [](ProofWriter &writer) {
+          const Clause clause = {Lit(0, true), Lit(1, false), Lit(100, true)};
+          writer.add(clause.begin(), clause.end());
+          writer.remove(clause.begin(), clause.begin() + 1);
+        });
+    // 2 * (var + 1) + sign in 7-bit groups
+    assert(binary == string("a\x02\x05\xca\x01\x00"
+                            "d\x02\x00",
+                            9));
+  }
+  for (const bool preprocess : {true, false}) {
+    std::istringstream in(pigeonhole_cnf(5));
+    const CnfData cnf = parse_cnf(in);
+    const string proof =
+        write_proof(ProofFormat::Drat, [&](ProofWriter &writer) {
+          Solver solver;
+          solver.options.preprocess = preprocess;
+          solver.set_proof(&writer);
+          solver.load(cnf);
+          assert(solver.solve() == Status::Unsat);
+        });
+    check_proof(cnf, proof);
+  }
+  {
+    // units and false literals at the top level
+    std::istringstream in("p cnf 3 4\n1 0\n-1 2 3 0\n-2 0\n-3 -1 0\n");
+    const CnfData cnf = parse_cnf(in);
+    const string proof =
+        write_proof(ProofFormat::Drat, [&](ProofWriter &writer) {
+          Solver solver;
+          solver.set_proof(&writer);
+          solver.load(cnf);
+          assert(solver.solve() == Status::Unsat);
+        });
+    check_proof(cnf, proof);
+  }
+}
+
+struct VmtfLubyTraits : DefaultTraits {
+  static constexpr std::optional<DecisionKind> decision = DecisionKind::Vmtf;
+  static constexpr std::optional<RestartKind> restart = RestartKind::Luby;
+  static constexpr bool assumptions = false;
+  static constexpr bool proof = false;
+  static constexpr bool stats = true;
+};
+
+void test_traits() {
+  test_start(__func__);
+  std::istringstream in(pigeonhole_cnf(6));
+  const CnfData cnf = parse_cnf(in);
+  // fixed choices search like the same choices in Options
+  Solver solver;
+  solver.options.decision = DecisionKind::Vmtf;
+  solver.options.restart = RestartKind::Luby;
+  solver.load(cnf);
+  assert(solver.solve() == Status::Unsat);
+  assert(solver.stats().decisions == 0);
+
+  BasicSolver<VmtfLubyTraits> fixed;
+  const string proof = write_proof(ProofFormat::Drat, [&](ProofWriter &writer) {
+    fixed.set_proof(&writer);
+    fixed.load(cnf);
+    assert(fixed.solve() == Status::Unsat);
+  });
+  // proof logging is compiled out
+  assert(proof.empty());
+  assert(fixed.num_conflicts() == solver.num_conflicts());
+  const Statistics &stats = fixed.stats();
+  assert(stats.decisions > 0);
+  assert(stats.learnt_units + stats.learnt_binaries <= fixed.num_conflicts());
+  assert(stats.learnt_literals >= fixed.num_conflicts());
+  assert(stats.reduced_learnts <= fixed.num_conflicts());
+  assert((stats.reductions > 0) == (stats.reduced_learnts > 0));
+  // the traits disable assumptions
+  bool thrown = false;
+  try {
+    fixed.solve({Lit(0, true)});
+  } catch (const std::invalid_argument &) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
 int main() {
   cerr << "===================== test ===================== " << endl;
   test_heap();
+  test_vmtf();
+  test_lrb();
   test_lit();
+  test_clause_arena();
   test_enqueue_and_eval();
   test_propagate();
   test_queue();
   test_analyze();
   test_solve();
+  test_load();
+  test_restart();
+  test_rephase();
+  test_budget();
+  test_incremental();
+  test_eliminator();
+  test_inprocess();
+  test_vivify();
+  test_shared_ring();
+  test_portfolio();
+  test_cube_and_conquer();
+  test_coordinator();
+  test_proof();
+  test_traits();
   test_parse_cnf();
+  test_compressed_input();
 }